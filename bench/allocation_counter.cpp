@@ -0,0 +1,138 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "allocation_counter.hpp"
+
+
+static std::atomic<std::uint64_t> allocations{ 0 };
+
+std::uint64_t allocationCount()
+{
+  return allocations.load(std::memory_order_relaxed);
+}
+
+// Null when out of memory.
+static void* allocate(std::size_t size, std::size_t alignment) noexcept
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  size = size == 0 ? 1 : size;
+  if (alignment <= alignof(std::max_align_t))
+  {
+    return std::malloc(size);
+  }
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);     // a multiple of the alignment
+}
+
+static void* allocateOrThrow(std::size_t size, std::size_t alignment)
+{
+  if (void* memory = allocate(size, alignment))
+  {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+
+void* operator new(std::size_t size)
+{
+  return allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size)
+{
+  return allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+  return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+
+// Every form of delete frees what one of the above allocated.
+void operator delete(void* memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(memory);
+}
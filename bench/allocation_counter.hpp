@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// Number of heap allocations the process has made so far. Linking allocation_counter.cpp replaces every
+// form of the global operator new (array, aligned and nothrow included) with one that counts.
+std::uint64_t allocationCount();
@@ -0,0 +1,245 @@
+// Throughput benchmark for the matching engines.
+//
+// Generates deterministic corpora, runs a matrix of patterns over them through the same whole-buffer
+// line search the CLI uses, and prints one JSON document on stdout:
+//   { "results": [ { "corpus", "pattern", "path", "bytes", "lines_matched", "seconds", "mb_per_s",
+//                    "matches_per_s", "allocations_per_match", "budget_exceeded" }, ... ],
+// "path" is what compilePatternSet dispatched the pattern to: a fast path ("literal", "anchored_literal",
+// "class_run"), the automaton ("literal_set") or "generic", the engines. Patterns that got anything but
+// "generic" are run a second time with their fast path switched off, so each row has its baseline.
+//     "validation": [ { "pattern", "input", "static_ns", "runtime_ns" }, ... ] }
+// The validation rows time whole-field matching of short inputs with grepcpp::match against match_main.
+// That the two agree is checked by tests/static_match_agreement.cpp, and that matching allocates nothing
+// by tests/allocation_check.cpp.
+//
+// Usage: bench [--quick] [--filter TEXT] [--min-time SECONDS]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "allocation_counter.hpp"
+#include "corpus.hpp"
+#include "fast_path.hpp"
+#include "line_search.hpp"
+#include "main.hpp"
+#include "match_scratch.hpp"
+#include "pattern_set.hpp"
+#include "static_match.hpp"
+
+
+static void escapeJson(std::string& out, std::string_view text)
+{
+  for (char c : text)
+  {
+    if (c == '"' || c == '\\')
+    {
+      out.push_back('\\');
+    }
+    out.push_back(c);
+  }
+}
+
+// Makes `value` look read by code the optimizer cannot see into, so the work producing it is kept.
+template <typename T>
+static void doNotOptimize(const T& value)
+{
+  asm volatile("" : : "r"(value) : "memory");
+}
+
+// Nanoseconds per call of `match` on `input`, repeated for about `min_time` seconds.
+template <typename Match>
+static double nanosecondsPerCall(Match&& match, std::string_view input, double min_time)
+{
+  std::uint64_t calls = 0;
+  std::uint64_t matched = 0;
+  auto start = std::chrono::steady_clock::now();
+  double seconds = 0;
+  do
+  {
+    for (int i = 0; i < 10000; ++i)
+    {
+      const char* volatile data = input.data();     // keeps the input opaque to the optimizer
+      matched += match(std::string_view(data, input.size())) ? 1 : 0;
+    }
+    calls += 10000;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (seconds < min_time);
+  doNotOptimize(matched);                           // the results must look used
+  return seconds * 1e9 / static_cast<double>(calls);
+}
+
+// One validation row: the same whole-input pattern through grepcpp::match and through match_main. That the
+// two agree is checked by tests/static_match_agreement.cpp.
+template <grepcpp::FixedString Pattern>
+static void validationCase(std::string_view input, double min_time, std::string& json, bool& first)
+{
+  const std::string anchored = "^(" + std::string(Pattern.view()) + ")$";
+  auto pattern = compilePattern(anchored);
+  MatchScratch scratch{};
+  prepareMatchScratch(scratch, pattern);
+
+  double static_ns = nanosecondsPerCall([](std::string_view text) { return bool(grepcpp::match<Pattern>(text)); }, input, min_time);
+  double runtime_ns = nanosecondsPerCall([&](std::string_view text)
+    {
+      return match_main(pattern, text.data(), text.data() + text.size(), scratch).status == MatchStatus::Match;
+    }, input, min_time);
+
+  json += first ? "\n    { \"pattern\": \"" : ",\n    { \"pattern\": \"";
+  first = false;
+  escapeJson(json, Pattern.view());
+  json += "\", \"input\": \"";
+  escapeJson(json, input);
+  char row[128];
+  std::snprintf(row, sizeof(row), "\", \"static_ns\": %.2f, \"runtime_ns\": %.2f }", static_ns, runtime_ns);
+  json += row;
+
+  std::fprintf(stderr, "validate %-31.31s %8.1f ns static %8.1f ns runtime\n", std::string(Pattern.view()).c_str(), static_ns, runtime_ns);
+}
+
+// What compilePatternSet dispatched a set to, for the "path" column.
+static const char* pathName(const PatternSet& patterns)
+{
+  if (!patterns.literals.empty())
+  {
+    return "literal_set";
+  }
+  auto fast_path = patterns.programs.front().fast_path;
+  return fast_path == FastPath::None ? "generic" : fastPathName(fast_path);
+}
+
+// One result row: `patterns` over the corpus through PatternSetSearch, repeated for about `min_time` seconds.
+static void resultRow(const Corpus& corpus, const PatternCase& pattern_case, const PatternSet& patterns, const char* path,
+  double min_time, std::string& json, bool& first)
+{
+  MatchScratch scratch{};
+  prepareMatchScratch(scratch, patterns);
+  scratch.step_budget = 1'000'000;                   // keeps the catastrophic cases finite
+
+  std::uint64_t iterations = 0;
+  std::uint64_t lines_matched = 0;
+  std::uint64_t allocations_before = allocationCount();
+  auto start = std::chrono::steady_clock::now();
+  double seconds = 0;
+  do
+  {
+    PatternSetSearch search(patterns, scratch, corpus.text);
+    std::string_view line{};
+    int pattern_id{};
+    while (search.next(line, pattern_id))
+    {
+      ++lines_matched;
+    }
+    ++iterations;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (seconds < min_time);
+  std::uint64_t allocations = allocationCount() - allocations_before;
+
+  double bytes = static_cast<double>(corpus.text.size()) * static_cast<double>(iterations);
+  char row[512];
+  std::snprintf(row, sizeof(row),
+    "\"bytes\": %.0f, \"lines_matched\": %llu, \"seconds\": %.6f, \"mb_per_s\": %.2f, "
+    "\"matches_per_s\": %.1f, \"allocations_per_match\": %.4f, \"budget_exceeded\": %llu }",
+    bytes, static_cast<unsigned long long>(lines_matched), seconds, bytes / seconds / 1e6,
+    static_cast<double>(lines_matched) / seconds,
+    lines_matched ? static_cast<double>(allocations) / static_cast<double>(lines_matched) : 0.0,
+    static_cast<unsigned long long>(scratch.budget_exceeded));
+
+  json += first ? "\n    { " : ",\n    { ";
+  first = false;
+  json += "\"corpus\": \"" + corpus.name + "\", \"pattern\": \"";
+  escapeJson(json, pattern_case.pattern);
+  json += "\", \"path\": \"";
+  json += path;
+  json += "\", ";
+  json += row;
+
+  std::string label = corpus.name + "/" + pattern_case.name;
+  std::fprintf(stderr, "%-40s %-16s %10.1f MB/s\n", label.c_str(), path, bytes / seconds / 1e6);
+}
+
+
+struct Options
+{
+  bool quick{ false };
+  std::string filter{};
+  double min_time{ 0.3 };
+};
+
+int main(int argc, char* argv[])
+{
+  Options options{};
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string_view argument = argv[i];
+    if (argument == "--quick")
+    {
+      options.quick = true;
+      options.min_time = 0.02;
+    }
+    else if (argument == "--filter" && i + 1 < argc)
+    {
+      options.filter = argv[++i];
+    }
+    else if (argument == "--min-time" && i + 1 < argc)
+    {
+      options.min_time = std::strtod(argv[++i], nullptr);
+    }
+    else
+    {
+      std::fprintf(stderr, "usage: bench [--quick] [--filter TEXT] [--min-time SECONDS]\n");
+      return 2;
+    }
+  }
+
+  const size_t corpus_size = options.quick ? (1 << 20) : (16 << 20);
+  std::vector<Corpus> corpora{};
+  corpora.push_back(apacheLog(corpus_size, 20));
+  corpora.push_back(apacheLog(corpus_size, 5000));
+  corpora.push_back(jsonLog(corpus_size));
+  corpora.push_back(longLines(corpus_size));
+  corpora.push_back(adversarial(corpus_size / 4));
+
+  std::string json = "{\n  \"results\": [";
+  bool first = true;
+
+  for (const auto& corpus : corpora)
+  {
+    for (const auto& pattern_case : patternCases)
+    {
+      std::string label = corpus.name + "/" + pattern_case.name;
+      if (!options.filter.empty() && label.find(options.filter) == std::string::npos)
+      {
+        continue;
+      }
+
+      auto patterns = compilePatternSet({ pattern_case.pattern });
+      const char* path = pathName(patterns);
+      resultRow(corpus, pattern_case, patterns, path, options.min_time, json, first);
+      if (std::string_view(path) != "generic")
+      {
+        // The same pattern on the engines, as it ran before it had a fast path.
+        PatternSet generic{};
+        generic.programs.push_back(compilePattern(pattern_case.pattern));
+        generic.programs.front().fast_path = FastPath::None;
+        resultRow(corpus, pattern_case, generic, "generic", options.min_time, json, first);
+      }
+    }
+  }
+
+  json += "\n  ],\n  \"validation\": [";
+  if (options.filter.empty() || std::string_view("validation").find(options.filter) != std::string_view::npos)
+  {
+    bool first_row = true;
+    validationCase<"(\\w+)@(\\w+)\\.com">("jane_doe@example.com", options.min_time, json, first_row);
+    validationCase<"\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}">("192.168.100.7", options.min_time, json, first_row);
+    validationCase<"(GET|POST|PUT|DELETE) /\\S*">("POST /api/v1/orders", options.min_time, json, first_row);
+  }
+  json += "\n  ]\n}\n";
+  std::fputs(json.c_str(), stdout);
+  return 0;
+}
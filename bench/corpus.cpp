@@ -0,0 +1,82 @@
+#include "corpus.hpp"
+
+
+static std::string number(Random& random, size_t bound)
+{
+  return std::to_string(random.below(bound));
+}
+
+Corpus apacheLog(size_t target_size, size_t error_one_in)
+{
+  static const char* methods[] = { "GET", "POST", "PUT", "DELETE" };
+  static const char* paths[] = { "/index.html", "/api/v1/users", "/static/app.js", "/login", "/api/v1/orders/search", "/img/logo.png" };
+  static const char* agents[] = { "Mozilla/5.0 (X11; Linux x86_64)", "curl/8.4.0", "Go-http-client/1.1", "python-requests/2.31" };
+
+  Random random{ 0x5eed0001 };
+  Corpus corpus{ error_one_in > 1000 ? "apache_sparse" : "apache_dense", {} };
+  while (corpus.text.size() < target_size)
+  {
+    bool error = random.below(error_one_in) == 0;
+    corpus.text += number(random, 256) + "." + number(random, 256) + "." + number(random, 256) + "." + number(random, 256);
+    corpus.text += " - - [17/Oct/2026:" + number(random, 24) + ":" + number(random, 60) + ":" + number(random, 60) + " +0000] \"";
+    corpus.text += methods[random.below(4)];
+    corpus.text += " ";
+    corpus.text += paths[random.below(6)];
+    corpus.text += " HTTP/1.1\" ";
+    corpus.text += error ? "500" : "200";
+    corpus.text += " ";
+    corpus.text += number(random, 100000) + " \"-\" \"" + agents[random.below(4)] + "\"";
+    if (error)
+    {
+      corpus.text += " ERROR upstream timeout";
+    }
+    corpus.text += "\n";
+  }
+  return corpus;
+}
+
+Corpus jsonLog(size_t target_size)
+{
+  static const char* levels[] = { "debug", "info", "info", "info", "warn", "error" };
+  static const char* services[] = { "auth", "billing", "search", "gateway" };
+
+  Random random{ 0x5eed0002 };
+  Corpus corpus{ "json", {} };
+  while (corpus.text.size() < target_size)
+  {
+    corpus.text += "{\"ts\":\"2026-10-17T" + number(random, 24) + ":" + number(random, 60) + ":" + number(random, 60) + "Z\",";
+    corpus.text += "\"level\":\"";
+    corpus.text += levels[random.below(6)];
+    corpus.text += "\",\"service\":\"";
+    corpus.text += services[random.below(4)];
+    corpus.text += "\",\"user\":\"user" + number(random, 5000) + "@example.com\",\"latency_ms\":" + number(random, 3000);
+    corpus.text += ",\"msg\":\"request handled\"}\n";
+  }
+  return corpus;
+}
+
+Corpus longLines(size_t target_size)
+{
+  Random random{ 0x5eed0003 };
+  Corpus corpus{ "long_lines", {} };
+  const size_t line_length = 1 << 20;
+  while (corpus.text.size() < target_size)
+  {
+    for (size_t i = 0; i < line_length; ++i)
+    {
+      corpus.text.push_back("abcdefghij klmnopqrst"[random.below(21)]);
+    }
+    corpus.text += "\n";
+  }
+  return corpus;
+}
+
+Corpus adversarial(size_t target_size)
+{
+  Corpus corpus{ "adversarial", {} };
+  while (corpus.text.size() < target_size)
+  {
+    corpus.text += std::string(64, 'a') + "\n";
+  }
+  return corpus;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Deterministic corpora and the pattern matrix shared by the benchmark and the allocation check.
+
+// xorshift64*: the same seed always yields the same corpus.
+struct Random
+{
+  std::uint64_t state;
+
+  std::uint64_t next()
+  {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+  }
+
+  size_t below(size_t bound) { return static_cast<size_t>(next() % bound); }
+};
+
+struct Corpus
+{
+  std::string name{};
+  std::string text{};
+};
+
+// Each corpus grows by whole lines until it holds at least `target_size` bytes.
+// Apache access log lines, one in `error_one_in` of them a 500 with " ERROR upstream timeout".
+Corpus apacheLog(size_t target_size, size_t error_one_in);
+Corpus jsonLog(size_t target_size);
+// Lines of 1 MiB.
+Corpus longLines(size_t target_size);
+// Inputs that make naive backtracking explode: long runs of 'a' that never complete a match.
+Corpus adversarial(size_t target_size);
+
+
+struct PatternCase
+{
+  const char* name;
+  const char* pattern;
+};
+
+inline constexpr PatternCase patternCases[] = {
+  { "literal", "timeout" },
+  { "literal_absent", "zzyzx" },
+  { "anchored_literal", "^GET" },
+  { "class_run", "\\d+" },
+  { "ip_quantified", "\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}" },
+  { "counted_class", "\"[^\"]{24,64}\"" },
+  { "negated_class", "\"[^\"]+\" 500" },
+  { "alternation", "GET|POST|DELETE" },
+  { "grouped_alternation", "\"(error|warn)\"" },
+  { "email", "\\w+@\\w+\\.com" },
+  { "end_anchored", "timeout$" },
+  { "backreference", "(\\d)\\1" },
+  { "backreference_word", "(\\w+)\\.\\1" },
+  { "nested_quantifier", "(a+)+b" },
+  { "alternation_star", "(a|aa)*c" },
+  { "dot_star_chain", ".*x.*y.*z" },
+};
@@ -0,0 +1,146 @@
+#include "aho_corasick.hpp"
+#include "simd_scan.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+
+AhoCorasick::AhoCorasick(const std::vector<std::string>& literals, const std::vector<int>& ids, bool ignore_case,
+  std::pmr::memory_resource* memory)
+  : transitions_(memory), output_(memory), first_byte_list_(memory)
+{
+  if (literals.size() != ids.size())
+  {
+    throw std::runtime_error("AhoCorasick needs one id per literal");
+  }
+
+  // Trie first; `rank` keeps the list position of the literal a state reports so ties go to the earlier one.
+  transitions_.assign(256, -1);
+  std::vector<size_t> rank{ SIZE_MAX };
+  for (size_t i = 0; i < literals.size(); ++i)
+  {
+    std::int32_t state = 0;
+    for (char byte : literals[i])
+    {
+      auto c = static_cast<unsigned char>(ignore_case ? toLowerAscii(byte) : byte);
+      auto& next = transitions_[state * 256 + c];
+      if (next == -1)
+      {
+        next = static_cast<std::int32_t>(rank.size());
+        rank.push_back(SIZE_MAX);
+        transitions_.resize(transitions_.size() + 256, -1);
+      }
+      state = transitions_[state * 256 + c];
+    }
+    rank[state] = std::min(rank[state], i);
+  }
+
+  // Breadth-first over the trie: missing edges copy the failure state's edge, and every state also reports
+  // what its failure state reports (a shorter literal ending at the same byte).
+  std::vector<std::int32_t> failure(rank.size(), 0);
+  std::vector<std::int32_t> queue{};
+  queue.reserve(rank.size());
+  for (int c = 0; c < 256; ++c)
+  {
+    auto& next = transitions_[c];
+    if (next == -1)
+    {
+      next = 0;
+    }
+    else
+    {
+      queue.push_back(next);
+    }
+  }
+  for (size_t head = 0; head < queue.size(); ++head)
+  {
+    std::int32_t state = queue[head];
+    rank[state] = std::min(rank[state], rank[failure[state]]);
+    for (int c = 0; c < 256; ++c)
+    {
+      auto& next = transitions_[state * 256 + c];
+      std::int32_t fallback = transitions_[failure[state] * 256 + c];
+      if (next == -1)
+      {
+        next = fallback;
+      }
+      else
+      {
+        failure[next] = fallback;
+        queue.push_back(next);
+      }
+    }
+  }
+  if (ignore_case)
+  {
+    for (size_t state = 0; state < rank.size(); ++state)
+    {
+      for (int c = 'A'; c <= 'Z'; ++c)
+      {
+        transitions_[state * 256 + c] = transitions_[state * 256 + c - 'A' + 'a'];
+      }
+    }
+  }
+
+  CharSet first_bytes{};
+  for (int c = 0; c < 256; ++c)
+  {
+    if (transitions_[c] != 0)
+    {
+      first_bytes.insert(static_cast<char>(c));
+      first_byte_list_.push_back(static_cast<char>(c));
+    }
+  }
+  first_bytes_ = ScanSet(first_bytes);
+  if (first_byte_list_.size() > 3)
+  {
+    first_byte_list_.clear();
+  }
+
+  output_.resize(rank.size());
+  for (size_t state = 0; state < rank.size(); ++state)
+  {
+    output_[state] = rank[state] == SIZE_MAX ? -1 : ids[rank[state]];
+  }
+}
+
+const char* AhoCorasick::find(const char* text_start, const char* text_end, int& id) const
+{
+  if (output_.empty())
+  {
+    return nullptr;
+  }
+  if (output_[0] != -1)
+  {
+    id = output_[0];                                // an empty literal matches before the first byte
+    return text_start;
+  }
+
+  std::int32_t state = 0;
+  for (const char* text_it = text_start; text_it != text_end; ++text_it)
+  {
+    if (state == 0)
+    {
+      // Back at the root nothing is partially matched, so skip to the next byte that starts a literal.
+      text_it = first_byte_list_.empty() ? findInSet(text_it, text_end, first_bytes_)
+        : findAnyByte(text_it, text_end, first_byte_list_);
+      if (text_it == nullptr)
+      {
+        return nullptr;
+      }
+    }
+    state = transitions_[state * 256 + static_cast<unsigned char>(*text_it)];
+    if (output_[state] != -1)
+    {
+      id = output_[state];
+      return text_it + 1;
+    }
+  }
+  return nullptr;
+}
+
+size_t AhoCorasick::memoryUsage() const
+{
+  return transitions_.capacity() * sizeof(std::int32_t) + output_.capacity() * sizeof(int) + first_byte_list_.capacity();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pattern_allocator.hpp"
+#include "simd_scan.hpp"
+
+// Aho-Corasick automaton over a set of literal strings, built into a dense transition table so the scan
+// costs one lookup per byte however many literals there are. Used for the meta-character-free entries
+// of a -e/-f pattern list.
+class AhoCorasick
+{
+public:
+  AhoCorasick() = default;
+  // Finding literals[i] reports ids[i]. With `ignore_case` letters match either case: the literals go in
+  // lower case and every upper case byte takes the transitions of its lower case, so the scan is unchanged.
+  // The tables are allocated from `memory` (null: the global heap).
+  AhoCorasick(const std::vector<std::string>& literals, const std::vector<int>& ids, bool ignore_case = false,
+    std::pmr::memory_resource* memory = nullptr);
+
+  bool empty() const { return output_.empty(); }
+  size_t memoryUsage() const;                 // heap bytes held by the tables
+
+  // Finds the literal occurrence in [text_start, text_end) that ends first; at equal ends the literal
+  // listed first wins. Returns the position just past it and stores its id, or returns nullptr.
+  const char* find(const char* text_start, const char* text_end, int& id) const;
+
+private:
+  PatternVector<std::int32_t> transitions_{}; // state * 256 + byte -> next state
+  PatternVector<int> output_{};               // per state: id of the best literal ending there, or -1
+  ScanSet first_bytes_{};                     // bytes that leave the root state
+  PatternString first_byte_list_{};           // first_bytes_ spelled out when there are at most 3 of them
+};
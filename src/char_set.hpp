@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+constexpr bool is_w(const char c)
+{
+  return (
+    (c >= 'a' && c <= 'z') ||
+    (c >= 'A' && c <= 'Z') ||
+    (c >= '0' && c <= '9') ||
+    (c == '_')
+    );
+}
+constexpr bool is_W(const char c)
+{
+  return !is_w(c);
+}
+
+constexpr bool is_d(const char c)
+{
+  return c >= '0' && c <= '9';
+}
+constexpr bool is_D(const char c)
+{
+  return !is_d(c);
+}
+
+constexpr bool is_s(const char c)
+{
+  return (
+    (c == ' ') ||
+    (c == '\t') ||
+    (c == '\n') ||
+    (c == '\v') ||
+    (c == '\f') ||
+    (c == '\r')
+    );
+}
+constexpr bool is_S(const char c)
+{
+  return !is_s(c);
+}
+
+constexpr char toLowerAscii(const char c)
+{
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+
+// Set of bytes stored as a 256-bit bitmap: membership is one load and one bit test.
+struct CharSet
+{
+  std::array<std::uint64_t, 4> words{};
+
+  constexpr void insert(const char c)
+  {
+    auto byte = static_cast<unsigned char>(c);
+    words[byte >> 6] |= std::uint64_t{ 1 } << (byte & 63);
+  }
+
+  constexpr bool contains(const char c) const
+  {
+    auto byte = static_cast<unsigned char>(c);
+    return (words[byte >> 6] >> (byte & 63)) & 1;
+  }
+
+  constexpr CharSet& operator|=(const CharSet& other)
+  {
+    for (int i = 0; i < 4; ++i)
+    {
+      words[i] |= other.words[i];
+    }
+    return *this;
+  }
+
+  // The set plus the other case of every ASCII letter in it (-i).
+  constexpr CharSet foldCase() const
+  {
+    CharSet result = *this;
+    for (char lower = 'a'; lower <= 'z'; ++lower)
+    {
+      const char upper = static_cast<char>(lower - 'a' + 'A');
+      if (contains(lower) || contains(upper))
+      {
+        result.insert(lower);
+        result.insert(upper);
+      }
+    }
+    return result;
+  }
+
+  constexpr bool operator==(const CharSet& other) const = default;
+
+  constexpr CharSet complement() const
+  {
+    CharSet result{};
+    for (int i = 0; i < 4; ++i)
+    {
+      result.words[i] = ~words[i];
+    }
+    return result;
+  }
+
+  template <typename Predicate>
+  static constexpr CharSet fromPredicate(Predicate predicate)
+  {
+    CharSet result{};
+    for (int byte = 0; byte < 256; ++byte)
+    {
+      if (predicate(static_cast<char>(byte)))
+      {
+        result.insert(static_cast<char>(byte));
+      }
+    }
+    return result;
+  }
+
+  static constexpr CharSet single(const char c)
+  {
+    CharSet result{};
+    result.insert(c);
+    return result;
+  }
+};
+
+inline constexpr CharSet anyCharSet = CharSet{}.complement();
+inline constexpr CharSet wordCharSet = CharSet::fromPredicate(is_w);
+inline constexpr CharSet nonWordCharSet = CharSet::fromPredicate(is_W);
+inline constexpr CharSet digitCharSet = CharSet::fromPredicate(is_d);
+inline constexpr CharSet nonDigitCharSet = CharSet::fromPredicate(is_D);
+inline constexpr CharSet spaceCharSet = CharSet::fromPredicate(is_s);
+inline constexpr CharSet nonSpaceCharSet = CharSet::fromPredicate(is_S);
@@ -0,0 +1,1421 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <latch>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cli.hpp"
+#include "decompress.hpp"
+#include "io.hpp"
+#include "line_search.hpp"
+#include "main.hpp"
+#include "match.hpp"
+#include "match_scratch.hpp"
+#include "pattern_set.hpp"
+#include "searcher.hpp"
+#include "simd_scan.hpp"
+#include "stream_match.hpp"
+#include "thread_pool.hpp"
+
+
+static constexpr int exitMatch = 0;
+static constexpr int exitNoMatch = 1;
+static constexpr int exitError = 2;
+
+
+// The argument of the option at argv[i]; moves `i` past it.
+static std::string optionArgument(int argc, char* argv[], int& i)
+{
+  if (i + 1 == argc)
+  {
+    throw std::runtime_error("option '" + std::string(argv[i]) + "' requires an argument");
+  }
+  return argv[++i];
+}
+
+// Reads the numeric argument of the option at argv[i] and moves `i` past it.
+static std::uint64_t parseCount(int argc, char* argv[], int& i)
+{
+  std::string_view option = argv[i];
+  std::string count = optionArgument(argc, argv, i);
+  std::uint64_t value{};
+  auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), value);
+  if (count.empty() || error != std::errc{} || end != count.data() + count.size())
+  {
+    throw std::runtime_error("invalid argument '" + count + "' for '" + std::string(option) + "'");
+  }
+  return value;
+}
+
+// --color[=WHEN]: always, never or auto (the default: only when standard output is a terminal).
+static bool parseColor(std::string_view argument)
+{
+  auto equals = argument.find('=');
+  std::string_view when = equals == std::string_view::npos ? "auto" : argument.substr(equals + 1);
+  if (argument.substr(0, equals) != "--color" && argument.substr(0, equals) != "--colour")
+  {
+    throw std::runtime_error("unknown option '" + std::string(argument) + "'");
+  }
+  if (when == "always" || when == "yes" || when == "force")
+  {
+    return true;
+  }
+  if (when == "never" || when == "no" || when == "none")
+  {
+    return false;
+  }
+  if (when == "auto" || when == "tty" || when == "if-tty")
+  {
+    const char* term = std::getenv("TERM");
+    return ::isatty(STDOUT_FILENO) && term != nullptr && std::string_view(term) != "dumb";
+  }
+  throw std::runtime_error("invalid argument '" + std::string(when) + "' for '--color'");
+}
+
+// Appends the lines of a -f file to `patterns`, one pattern per line.
+static void readPatternFile(const std::string& path, std::vector<std::string>& patterns)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    throw std::runtime_error(path + ": " + std::strerror(errno));
+  }
+  for (std::string line{}; std::getline(file, line); )
+  {
+    patterns.push_back(std::move(line));
+  }
+}
+
+GrepOptions parseArguments(int argc, char* argv[])
+{
+  GrepOptions options{};
+  std::vector<std::string> operands{};
+  bool have_pattern = false;              // set by -e/-f; otherwise the first operand is the pattern
+  bool end_of_options = false;
+  std::uint64_t context = 0;              // -C, for whichever of -A and -B is not given
+  bool have_context = false;
+  bool have_before = false;
+  bool have_after = false;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string_view argument = argv[i];
+    if (!end_of_options && argument == "--")
+    {
+      end_of_options = true;
+    }
+    else if (!end_of_options && argument == "-E")
+    {
+      // Extended syntax is the only syntax this grep speaks.
+    }
+    else if (!end_of_options && argument == "-r")
+    {
+      options.recursive = true;
+    }
+    else if (!end_of_options && argument == "-i")
+    {
+      options.ignore_case = true;
+    }
+    else if (!end_of_options && argument == "-n")
+    {
+      options.line_numbers = true;
+    }
+    else if (!end_of_options && argument == "-e")
+    {
+      options.patterns.push_back(optionArgument(argc, argv, i));
+      have_pattern = true;
+    }
+    else if (!end_of_options && argument == "-f")
+    {
+      readPatternFile(optionArgument(argc, argv, i), options.patterns);
+      have_pattern = true;
+    }
+    else if (!end_of_options && argument == "-o")
+    {
+      options.only_matching = true;
+    }
+    else if (!end_of_options && argument == "-b")
+    {
+      options.byte_offsets = true;
+    }
+    else if (!end_of_options && argument == "-c")
+    {
+      options.count_only = true;
+    }
+    else if (!end_of_options && argument == "-l")
+    {
+      options.files_with_matches = true;
+    }
+    else if (!end_of_options && (argument == "-a" || argument == "--text"))
+    {
+      options.binary_text = true;
+    }
+    else if (!end_of_options && argument == "-A")
+    {
+      options.after_context = parseCount(argc, argv, i);
+      have_after = true;
+    }
+    else if (!end_of_options && argument == "-B")
+    {
+      options.before_context = parseCount(argc, argv, i);
+      have_before = true;
+    }
+    else if (!end_of_options && argument == "-C")
+    {
+      context = parseCount(argc, argv, i);
+      have_context = true;
+    }
+    else if (!end_of_options && (argument.starts_with("--color") || argument.starts_with("--colour")))
+    {
+      options.color = parseColor(argument);
+    }
+    else if (!end_of_options && argument == "--pattern-id")
+    {
+      options.pattern_ids = true;
+    }
+    else if (!end_of_options && argument == "--daemon")
+    {
+      options.daemon_socket = optionArgument(argc, argv, i);
+    }
+    else if (!end_of_options && argument == "--stats")
+    {
+      options.stats = true;
+    }
+    else if (!end_of_options && argument == "--no-sort")
+    {
+      options.sort_output = false;
+    }
+    else if (!end_of_options && argument == "-j")
+    {
+      options.jobs = static_cast<unsigned>(parseCount(argc, argv, i));
+    }
+    else if (!end_of_options && argument == "--match-budget")
+    {
+      options.match_budget = parseCount(argc, argv, i);
+    }
+    else if (!end_of_options && argument.size() > 1 && argument.front() == '-')
+    {
+      throw std::runtime_error("unknown option '" + std::string(argument) + "'");
+    }
+    else
+    {
+      operands.emplace_back(argument);
+    }
+  }
+
+  if (!have_pattern && !operands.empty())
+  {
+    options.patterns.push_back(std::move(operands.front()));
+    operands.erase(operands.begin());
+    have_pattern = true;
+  }
+  options.files = std::move(operands);
+  options.before_context = have_before ? options.before_context : context;
+  options.after_context = have_after ? options.after_context : context;
+  options.context = have_before || have_after || have_context;
+  if (!have_pattern && options.daemon_socket.empty())
+  {
+    throw std::runtime_error("usage: grep -E [-r] [-i] [-n] [-o] [-b] [-c] [-l] [-a] [-A N] [-B N] [-C N] [--color[=WHEN]] [-j N] [--no-sort] [--match-budget N] [--pattern-id] [--stats]\n"
+      "               {PATTERN | -e PATTERN... | -f FILE...} [FILE...]\n"
+      "       grep --daemon SOCKET [-i] [-n] [-o] [-b] [-c] [-l] [-a] [-A N] [-B N] [-C N] [-j N] [--match-budget N]");
+  }
+  return options;
+}
+
+
+// Files at least this large are split into chunks of this size and searched on every core.
+static constexpr size_t parallelChunkSize = 16 * 1024 * 1024;
+// Files are checked for NUL bytes in blocks of this size at fixed offsets, as GNU grep checks its 96 KiB
+// read buffers: a NUL before the end of a matching line's block makes the file binary.
+static constexpr std::uint64_t binaryCheckBlock = 96 * 1024;
+static constexpr std::uint64_t noNul = std::numeric_limits<std::uint64_t>::max();
+
+
+// Output collected in memory so a worker can search a file while earlier files are still printing.
+struct BufferOutput
+{
+  std::string text{};
+
+  void write(std::string_view chunk) { text.append(chunk); }
+  void put(char c) { text.push_back(c); }
+};
+
+// How a matching line is printed.
+struct LineFormat
+{
+  std::string_view label{};               // file name, empty when names are not shown
+  bool line_numbers{ false };
+  bool pattern_ids{ false };
+  bool byte_offsets{ false };
+  bool only_matching{ false };
+  bool color{ false };
+  bool count_only{ false };               // -c: count the matching lines, print none of them
+  bool files_only{ false };               // -l: stop at the first matching line
+  bool context{ false };                  // -A, -B or -C: group the lines printed, "--" between groups
+  std::uint64_t before{ 0 };
+  std::uint64_t after{ 0 };
+  bool separate_first_group{ false };     // an earlier file printed a group, so "--" precedes the first one
+  bool detect_binary{ false };            // not -a: once a NUL byte shows up, a match stops the file (see FileProgress::binary)
+};
+
+// What the search of one file carries from one buffer to the next.
+struct FileProgress
+{
+  std::uint64_t line_number{ 1 };         // number of the next buffer's first line (kept with line numbers only)
+  std::uint64_t matching_lines{};
+  std::uint64_t after_pending{};          // context lines still owed to the last matching line
+  std::uint64_t printed_end{};            // file offset past the last line printed (or, with -o, passed over)
+  bool printed{ false };                  // a group of lines was printed; a gap before the next one gets "--"
+  std::string before_lines{};             // with -B, the last unprinted lines of the previous buffer, up to -B of them
+  bool binary{ false };                   // a NUL byte was seen, so the file holds binary data
+  bool binary_matched{ false };           // ...and a line matched: "binary file matches" stands in for the rest
+  std::uint64_t nul_checked_to{};         // file offset: no NUL byte before it
+  std::uint64_t nul_at{ noNul };          // file offset of a NUL byte known to lie further on (see searchChunks)
+};
+
+// Workers a single large file can be split across.
+struct ChunkWorkers
+{
+  ThreadPool& pool;
+  std::vector<MatchScratch>& scratches;
+};
+
+// SGR sequences of GNU grep's default GREP_COLORS.
+static constexpr std::string_view colorMatch = "\33[01;31m\33[K";
+static constexpr std::string_view colorFileName = "\33[35m\33[K";
+static constexpr std::string_view colorNumber = "\33[32m\33[K";
+static constexpr std::string_view colorSeparator = "\33[36m\33[K";
+static constexpr std::string_view colorEnd = "\33[m\33[K";
+
+// `separator` follows the field: ':' on matching lines, '-' on context lines.
+template <typename Output>
+static void writeField(const LineFormat& format, std::string_view color, std::string_view text, char separator, Output& output)
+{
+  if (format.color)
+  {
+    output.write(color);
+    output.write(text);
+    output.write(colorEnd);
+    output.write(colorSeparator);
+    output.put(separator);
+    output.write(colorEnd);
+  }
+  else
+  {
+    output.write(text);
+    output.put(separator);
+  }
+}
+
+static std::string_view formatNumber(std::uint64_t number, char (&digits)[24])
+{
+  auto [digits_end, error] = std::to_chars(digits, digits + sizeof(digits), number);
+  return std::string_view(digits, digits_end - digits);
+}
+
+template <typename Output>
+static void writeNumberField(const LineFormat& format, std::uint64_t number, char separator, Output& output)
+{
+  char digits[24];
+  writeField(format, colorNumber, formatNumber(number, digits), separator, output);
+}
+
+// The file name, line number, byte offset and pattern number fields that are switched on, in GNU order.
+// Context lines pass a negative `pattern_id` and get no pattern number.
+template <typename Output>
+static void writePrefix(const LineFormat& format, std::uint64_t line_number, std::uint64_t byte_offset, int pattern_id, char separator,
+  Output& output)
+{
+  if (!format.label.empty())
+  {
+    writeField(format, colorFileName, format.label, separator, output);
+  }
+  if (format.line_numbers)
+  {
+    writeNumberField(format, line_number, separator, output);
+  }
+  if (format.byte_offsets)
+  {
+    writeNumberField(format, byte_offset, separator, output);
+  }
+  if (format.pattern_ids && pattern_id >= 0)
+  {
+    writeNumberField(format, static_cast<std::uint64_t>(pattern_id) + 1, separator, output);
+  }
+}
+
+// The "--" line between groups of context lines that are not adjacent.
+template <typename Output>
+static void writeGroupSeparator(bool color, Output& output)
+{
+  output.write(color ? colorSeparator : std::string_view{});
+  output.write("--");
+  output.write(color ? colorEnd : std::string_view{});
+  output.put('\n');
+}
+
+template <typename Output>
+static void writeContextLine(const LineFormat& format, std::uint64_t line_number, std::uint64_t byte_offset, std::string_view line,
+  Output& output)
+{
+  if (format.only_matching)
+  {
+    return;                               // -o prints no context, only the separators between groups
+  }
+  writePrefix(format, line_number, byte_offset, -1, '-', output);
+  output.write(line);
+  output.put('\n');
+}
+
+// The start of the line before the one starting at `line_start`, looking no further back than `limit`.
+static const char* previousLineStart(const char* limit, const char* line_start)
+{
+  auto newline = findLastByte(limit, line_start - 1, '\n');
+  return newline != nullptr ? newline + 1 : limit;
+}
+
+// The start of the `count`th last line of [limit, end), or `limit` when there are fewer lines; `count`
+// is lowered by the number of lines found.
+static const char* lastLinesStart(const char* limit, const char* end, std::uint64_t& count)
+{
+  const char* start = end;
+  for (; count > 0 && start > limit; --count)
+  {
+    start = previousLineStart(limit, start);
+  }
+  return start;
+}
+
+// Sets progress.binary when the file holds a NUL byte before the file offset `check_end`. Only the part of
+// `buffer`, which starts `buffer_offset` bytes into the file, past progress.nul_checked_to is looked at:
+// the file before it was checked along with the earlier buffers.
+static void checkBinary(std::string_view buffer, std::uint64_t buffer_offset, std::uint64_t check_end, FileProgress& progress)
+{
+  if (progress.binary || check_end <= progress.nul_checked_to)
+  {
+    return;
+  }
+  const std::uint64_t check_start = std::max(progress.nul_checked_to, buffer_offset);
+  const std::uint64_t buffer_check_end = std::min<std::uint64_t>(check_end, buffer_offset + buffer.size());
+  progress.binary = progress.nul_at < check_end || (check_start < buffer_check_end
+    && findByte(buffer.data() + (check_start - buffer_offset), buffer.data() + (buffer_check_end - buffer_offset), '\0') != nullptr);
+  progress.nul_checked_to = std::max(progress.nul_checked_to, buffer_check_end);
+}
+
+// Prints the matching lines of a buffer of whole lines that starts `buffer_offset` bytes into its file,
+// and moves `progress` past the buffer. With -o each match is printed on its own line instead of the
+// whole line; -c only counts the lines and -l stops at the first one.
+//
+// As in GNU grep, a file is binary once a NUL byte shows up. It is only looked for when a line is about
+// to be printed, from where the search of the file last looked (progress.nul_checked_to) up to the end of
+// the line's binaryCheckBlock. A line that matches in binary data is not printed: the search of the file
+// stops with progress.binary_matched set.
+//
+// Context is worked out from the matching lines instead of being tracked line by line, so the
+// prefilter still skips everything in between. Lines before a match are found by scanning back from it
+// (no further than the last line printed, then into the lines kept from the previous buffer), and lines
+// after it by scanning forward until the next match or the end of the buffer.
+template <typename Output>
+static bool writeMatchingLines(const PatternSet& patterns, MatchScratch& scratch, std::string_view buffer,
+  const LineFormat& format, FileProgress& progress, std::uint64_t buffer_offset, Output& output)
+{
+  const char* text_end = buffer.data() + buffer.size();
+  const char* counted_to = buffer.data();
+  const char* printed_to = buffer.data();           // context: the lines before it are printed or not wanted
+  PatternSetSearch search(patterns, scratch, buffer);
+  std::string_view line{};
+  int pattern_id{};
+  Match match{};
+  bool matched = false;
+
+  if constexpr (statsEnabled)
+  {
+    scratch.stats.bytes_scanned += buffer.size();
+  }
+
+  auto offsetOf = [&](const char* position) { return buffer_offset + static_cast<std::uint64_t>(position - buffer.data()); };
+  auto lineNumberAt = [&](const char* position)
+    {
+      if (format.line_numbers)
+      {
+        progress.line_number += countByte(counted_to, position, '\n');
+        counted_to = position;
+      }
+      return progress.line_number;
+    };
+  auto writeNextContextLine = [&]
+    {
+      auto newline = findByte(printed_to, text_end, '\n');
+      const char* line_end = newline != nullptr ? newline : text_end;
+      writeContextLine(format, lineNumberAt(printed_to), offsetOf(printed_to), std::string_view(printed_to, line_end - printed_to), output);
+      printed_to = newline != nullptr ? newline + 1 : text_end;
+      progress.printed_end = offsetOf(printed_to);
+    };
+
+  while (search.next(line, pattern_id))
+  {
+    matched = true;
+    ++progress.matching_lines;
+    if constexpr (statsEnabled)
+    {
+      ++scratch.stats.matching_lines;
+      ++scratch.stats.pattern_lines[pattern_id];
+    }
+    if (format.files_only)
+    {
+      return true;
+    }
+    if (format.count_only)
+    {
+      continue;
+    }
+    if (format.detect_binary)
+    {
+      checkBinary(buffer, buffer_offset, (offsetOf(line.data() + line.size()) / binaryCheckBlock + 1) * binaryCheckBlock, progress);
+    }
+    if (progress.binary)
+    {
+      for (; format.context && progress.after_pending > 0 && printed_to < line.data(); --progress.after_pending)
+      {
+        writeNextContextLine();                     // the previous match's after-context still comes first
+      }
+      progress.binary_matched = true;
+      return true;
+    }
+
+    if (format.context)
+    {
+      // What is left of the previous match's after-context, then this match's before-context.
+      for (; progress.after_pending > 0 && printed_to < line.data(); --progress.after_pending)
+      {
+        writeNextContextLine();
+      }
+      std::uint64_t wanted = format.before;
+      const char* before_start = lastLinesStart(printed_to, line.data(), wanted);
+      std::string_view carried{};
+      if (wanted > 0 && before_start == buffer.data())
+      {
+        carried = progress.before_lines;
+        carried.remove_prefix(static_cast<size_t>(lastLinesStart(carried.data(), carried.data() + carried.size(), wanted) - carried.data()));
+      }
+
+      const std::uint64_t group_start = offsetOf(before_start) - carried.size();
+      if (progress.printed ? group_start > progress.printed_end : format.separate_first_group)
+      {
+        writeGroupSeparator(format.color, output);
+      }
+      progress.printed = true;
+      std::uint64_t carried_number = progress.line_number - countByte(carried.data(), carried.data() + carried.size(), '\n');
+      for (size_t carried_at = 0; carried_at < carried.size(); )
+      {
+        size_t carried_end = carried.find('\n', carried_at);
+        writeContextLine(format, carried_number++, group_start + carried_at, carried.substr(carried_at, carried_end - carried_at), output);
+        carried_at = carried_end + 1;
+      }
+      for (printed_to = before_start; printed_to < line.data(); )
+      {
+        writeNextContextLine();
+      }
+    }
+
+    lineNumberAt(line.data());
+    if (format.only_matching)
+    {
+      MatchIterator matches(patterns, scratch, line);
+      while (matches.next(match))
+      {
+        if (match.start == match.end)
+        {
+          continue;
+        }
+        writePrefix(format, progress.line_number, offsetOf(match.start), match.pattern, ':', output);
+        output.write(format.color ? colorMatch : std::string_view{});
+        output.write(match.text());
+        output.write(format.color ? colorEnd : std::string_view{});
+        output.put('\n');
+      }
+    }
+    else
+    {
+      writePrefix(format, progress.line_number, offsetOf(line.data()), pattern_id, ':', output);
+      if (format.color)
+      {
+        const char* colored_to = line.data();
+        MatchIterator matches(patterns, scratch, line);
+        while (matches.next(match))
+        {
+          if (match.start == match.end)
+          {
+            continue;
+          }
+          output.write(std::string_view(colored_to, match.start - colored_to));
+          output.write(colorMatch);
+          output.write(match.text());
+          output.write(colorEnd);
+          colored_to = match.end;
+        }
+        output.write(std::string_view(colored_to, line.data() + line.size() - colored_to));
+      }
+      else
+      {
+        output.write(line);
+      }
+      output.put('\n');
+    }
+
+    if (format.context)
+    {
+      printed_to = std::min(line.data() + line.size() + 1, text_end);
+      progress.printed_end = offsetOf(printed_to);
+      progress.after_pending = format.after;
+    }
+  }
+
+  if (format.context)
+  {
+    for (; progress.after_pending > 0 && printed_to < text_end; --progress.after_pending)
+    {
+      writeNextContextLine();
+    }
+    if (format.before != 0)
+    {
+      // Keep the last lines not printed for a match at the start of the next buffer. When this buffer
+      // holds fewer than -B of them, the lines kept from earlier buffers still count.
+      std::uint64_t wanted = format.before;
+      const char* tail = lastLinesStart(printed_to, text_end, wanted);
+      if (wanted > 0 && tail == buffer.data())
+      {
+        std::string_view older = progress.before_lines;
+        progress.before_lines.erase(0, static_cast<size_t>(lastLinesStart(older.data(), older.data() + older.size(), wanted) - older.data()));
+        progress.before_lines.append(tail, text_end);
+      }
+      else
+      {
+        progress.before_lines.assign(tail, text_end);
+      }
+    }
+  }
+
+  if (format.line_numbers)
+  {
+    progress.line_number += countByte(counted_to, text_end, '\n');
+  }
+  return matched;
+}
+
+// Splits a mapped file at line boundaries and searches the chunks in parallel. Line numbers come from
+// a parallel count of the newlines in each chunk followed by a prefix sum; the file's first NUL byte is
+// found in the same pass, so every chunk judges its matches binary exactly as a search of the whole file
+// would. Chunk outputs are printed in order; at most two chunks per worker are in flight so buffered
+// output stays bounded. With -l, chunks not yet started when one of them has matched are skipped. A
+// chunk that finds the file binary ends it: the chunks after it are skipped, or their output dropped.
+template <typename Output>
+static bool searchChunks(const PatternSet& patterns, std::string_view contents, const LineFormat& format,
+  ChunkWorkers& workers, FileProgress& progress, Output& output)
+{
+  std::vector<std::string_view> chunks{};
+  const char* text_end = contents.data() + contents.size();
+  for (const char* chunk_start = contents.data(); chunk_start < text_end; )
+  {
+    const char* chunk_end = text_end;
+    if (static_cast<size_t>(text_end - chunk_start) > parallelChunkSize)
+    {
+      auto newline = findByte(chunk_start + parallelChunkSize, text_end, '\n');
+      chunk_end = newline ? newline + 1 : text_end;
+    }
+    chunks.emplace_back(chunk_start, chunk_end - chunk_start);
+    chunk_start = chunk_end;
+  }
+
+  // When lines are printed, each chunk also records where its first NUL byte is: a chunk cannot tell
+  // whether its matches are binary before every earlier chunk has been looked at.
+  const bool find_nul = format.detect_binary && !format.count_only && !format.files_only;
+  std::vector<std::uint64_t> first_line(chunks.size(), 1);
+  std::uint64_t first_nul = noNul;
+  if (format.line_numbers || find_nul)
+  {
+    std::vector<std::uint64_t> newlines(chunks.size());
+    std::vector<std::uint64_t> nul_at(chunks.size(), noNul);
+    std::latch counted(static_cast<std::ptrdiff_t>(chunks.size()));
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+      workers.pool.submit([&, i](size_t)
+        {
+          const char* chunk_end = chunks[i].data() + chunks[i].size();
+          if (format.line_numbers)
+          {
+            newlines[i] = countByte(chunks[i].data(), chunk_end, '\n');
+          }
+          if (find_nul)
+          {
+            auto nul = findByte(chunks[i].data(), chunk_end, '\0');
+            nul_at[i] = nul != nullptr ? static_cast<std::uint64_t>(nul - contents.data()) : noNul;
+          }
+          counted.count_down();
+        });
+    }
+    counted.wait();
+    for (size_t i = 1; i < chunks.size(); ++i)
+    {
+      first_line[i] = first_line[i - 1] + newlines[i - 1];
+    }
+    first_nul = *std::min_element(nul_at.begin(), nul_at.end());
+  }
+
+  struct ChunkResult
+  {
+    BufferOutput output{};
+    std::uint64_t matching_lines{};
+    bool matched{ false };
+    bool binary{ false };
+    std::exception_ptr error{};           // what the search of the chunk threw, rethrown once every chunk is done
+    bool done{ false };
+  };
+  std::vector<ChunkResult> results(chunks.size());
+  std::mutex results_mutex{};
+  std::condition_variable result_ready{};
+  std::atomic<bool> found{ false };
+  std::atomic<size_t> first_binary{ chunks.size() };
+  bool matched = false;
+  std::exception_ptr error{};
+
+  auto print = [&](size_t i)
+    {
+      std::unique_lock lock(results_mutex);
+      result_ready.wait(lock, [&] { return results[i].done; });
+      error = error ? error : results[i].error;
+      if (!progress.binary_matched && !error)
+      {
+        output.write(results[i].output.text);
+        matched |= results[i].matched;
+        progress.matching_lines += results[i].matching_lines;
+        progress.binary_matched = results[i].binary;
+      }
+      results[i].output.text = std::string{};
+    };
+
+  const size_t window = 2 * workers.pool.size();
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    if (i >= window)
+    {
+      print(i - window);
+    }
+    workers.pool.submit([&, i](size_t worker)
+      {
+        auto& result = results[i];
+        FileProgress chunk_progress{ first_line[i] };
+        chunk_progress.nul_checked_to = first_nul;          // the whole file has been looked at already
+        chunk_progress.nul_at = first_nul;
+        std::uint64_t chunk_offset = static_cast<std::uint64_t>(chunks[i].data() - contents.data());
+        bool chunk_matched = false;
+        std::exception_ptr chunk_error{};
+        try
+        {
+          chunk_matched = !(format.files_only && found.load(std::memory_order_relaxed))
+            && i < first_binary.load(std::memory_order_relaxed)
+            && writeMatchingLines(patterns, workers.scratches[worker], chunks[i], format, chunk_progress, chunk_offset, result.output);
+        }
+        catch (...)
+        {
+          chunk_error = std::current_exception();
+        }
+        if (chunk_matched)
+        {
+          found.store(true, std::memory_order_relaxed);
+        }
+        if (chunk_progress.binary_matched)
+        {
+          size_t earliest = first_binary.load(std::memory_order_relaxed);
+          while (i < earliest && !first_binary.compare_exchange_weak(earliest, i, std::memory_order_relaxed))
+          {
+          }
+        }
+
+        std::lock_guard lock(results_mutex);
+        result.matched = chunk_matched;
+        result.binary = chunk_progress.binary_matched;
+        result.error = chunk_error;
+        result.matching_lines = chunk_progress.matching_lines;
+        result.done = true;
+        result_ready.notify_all();
+      });
+  }
+  for (size_t i = chunks.size() > window ? chunks.size() - window : 0; i < chunks.size(); ++i)
+  {
+    print(i);
+  }
+  if (error)
+  {
+    std::rethrow_exception(error);                  // the chunks before it are printed, none after
+  }
+  return matched;
+}
+
+// Searches the blocks of a LineReader or DecompressedBlocks one after another. With -l no block is read
+// after the first match, nor after a match in binary data. When lines are printed every block is checked
+// for NUL bytes before the next one replaces it, so a NUL makes the file binary for all later blocks; the
+// check for a matching line cannot look past its block's end. A line the reader split into partial blocks
+// (see LongLines) is matched piece by piece by a StreamMatcher and never held whole; it is only counted,
+// as splitting is only asked for when no line is to be printed.
+template <typename Blocks, typename Output>
+static bool searchBlocks(const PatternSet& patterns, MatchScratch& scratch, Blocks& blocks, const LineFormat& format,
+  FileProgress& progress, Output& output)
+{
+  std::string_view block{};
+  std::uint64_t block_offset = 0;
+  bool matched = false;
+  std::optional<StreamMatcher> long_line{};       // made at the first partial block
+  bool in_long_line = false;                      // the block last read ended inside a split line
+  std::chrono::steady_clock::time_point wait_start{};
+
+  // The split line is over (or decided early); returns true when that ends the search of the file.
+  auto endLongLine = [&]
+    {
+      in_long_line = false;
+      progress.line_number += format.line_numbers ? 1 : 0;
+      if (!long_line->finish())
+      {
+        return false;
+      }
+      matched = true;
+      ++progress.matching_lines;
+      if constexpr (statsEnabled)
+      {
+        ++scratch.stats.matching_lines;
+      }
+      progress.binary_matched = !format.count_only && !format.files_only;
+      return !format.count_only;
+    };
+
+  while (true)
+  {
+    if constexpr (statsEnabled)
+    {
+      wait_start = std::chrono::steady_clock::now();
+    }
+    if (!blocks.nextBlock(block))
+    {
+      if (in_long_line)
+      {
+        endLongLine();                            // the input ended with the last piece
+      }
+      break;
+    }
+    if constexpr (statsEnabled)
+    {
+      addElapsed(scratch.stats.io_time, wait_start);
+    }
+
+    if (in_long_line || blocks.partial())
+    {
+      // A piece of the split line: the whole block when it is partial, else the block up to its first '\n'.
+      auto newline = blocks.partial() ? nullptr : findByte(block.data(), block.data() + block.size(), '\n');
+      auto piece = block.substr(0, newline != nullptr ? static_cast<size_t>(newline - block.data()) : block.size());
+      if (!long_line)
+      {
+        long_line.emplace(patterns);
+      }
+      if (format.detect_binary)
+      {
+        checkBinary(piece, block_offset, block_offset + piece.size(), progress);
+      }
+      if (!long_line->matched())
+      {
+        long_line->feed(piece);
+      }
+      if constexpr (statsEnabled)
+      {
+        scratch.stats.bytes_scanned += piece.size();
+      }
+      const size_t consumed = std::min(piece.size() + 1, block.size());
+      block_offset += consumed;
+      block.remove_prefix(consumed);
+
+      in_long_line = blocks.partial();
+      if ((!in_long_line || (long_line->matched() && !format.count_only)) && endLongLine())
+      {
+        break;
+      }
+      if (in_long_line)
+      {
+        continue;
+      }
+    }
+
+    if (!block.empty())
+    {
+      matched |= writeMatchingLines(patterns, scratch, block, format, progress, block_offset, output);
+      if (format.detect_binary && !format.count_only && !format.files_only)
+      {
+        checkBinary(block, block_offset, block_offset + block.size(), progress);      // the block is gone after this
+      }
+      block_offset += block.size();
+    }
+    if ((matched && format.files_only) || progress.binary_matched)
+    {
+      break;
+    }
+  }
+  return matched;
+}
+
+// Writes every matching line of `fd`. Regular files are mapped and searched in one piece (split across
+// `workers` when large and workers are given, unless context lines are wanted: those may reach across
+// chunks); gzip and zstd files are decompressed on a separate thread while their earlier blocks are
+// searched, and anything else is read block by block. When no line is printed (-c, -l, or a file found
+// binary), a line longer than a block is split instead of being read into memory whole.
+template <typename Output>
+static bool searchFd(const PatternSet& patterns, MatchScratch& scratch, int fd, const LineFormat& format,
+  ChunkWorkers* workers, FileProgress& progress, Output& output)
+{
+  auto long_lines = !canStream(patterns) ? LongLines::Grow
+    : format.count_only || format.files_only ? LongLines::Split
+    : format.detect_binary ? LongLines::SplitBinary : LongLines::Grow;
+  MappedFile mapped(fd);
+  if (mapped.valid())
+  {
+    auto compression = detectCompression(mapped.contents());
+    if (compression != Compression::None)
+    {
+      DecompressedBlocks blocks(mapped.contents(), compression, long_lines);
+      return searchBlocks(patterns, scratch, blocks, format, progress, output);
+    }
+    if (workers != nullptr && mapped.contents().size() >= 2 * parallelChunkSize && !format.context)
+    {
+      return searchChunks(patterns, mapped.contents(), format, *workers, progress, output);
+    }
+    return writeMatchingLines(patterns, scratch, mapped.contents(), format, progress, 0, output);
+  }
+
+  LineReader reader(fd, 256 * 1024, long_lines);
+  return searchBlocks(patterns, scratch, reader, format, progress, output);
+}
+
+// What -c and -l print for a file once it has been searched.
+template <typename Output>
+static void writeFileSummary(const LineFormat& format, bool matched, const FileProgress& progress, Output& output)
+{
+  if (format.files_only)
+  {
+    if (matched)
+    {
+      output.write(format.color ? colorFileName : std::string_view{});
+      output.write(format.label);
+      output.write(format.color ? colorEnd : std::string_view{});
+      output.put('\n');
+    }
+    return;
+  }
+  if (!format.label.empty())
+  {
+    writeField(format, colorFileName, format.label, ':', output);
+  }
+  char digits[24];
+  output.write(formatNumber(progress.matching_lines, digits));
+  output.put('\n');
+}
+
+// What the search of one input found.
+struct InputResult
+{
+  bool matched{ false };
+  bool binary{ false };                   // a line matched in binary data; "binary file matches" stands in for the rest
+};
+
+// Opens and searches one input ("-" is standard input), then prints its -c count or -l name.
+// `follows_group` says an earlier input printed context lines. Throws when the input cannot be read or
+// searched (std::runtime_error, or std::bad_alloc for a line too long to hold); an input that fails part
+// way still gets its count or name for the lines searched before.
+template <typename Output>
+static InputResult searchPath(const PatternSet& patterns, MatchScratch& scratch, const std::string& path,
+  const GrepOptions& options, bool show_names, ChunkWorkers* workers, Output& output, bool follows_group = false)
+{
+  const bool summary = options.count_only || options.files_with_matches;
+  LineFormat format{ {}, options.line_numbers && !summary, options.pattern_ids, options.byte_offsets, options.only_matching, options.color,
+    options.count_only, options.files_with_matches, options.context && !summary, options.before_context, options.after_context,
+    follows_group, !options.binary_text };
+  const bool from_stdin = path == "-";
+  if (show_names || options.files_with_matches)
+  {
+    format.label = from_stdin ? std::string_view("(standard input)") : std::string_view(path);
+  }
+
+  int fd = from_stdin ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw std::runtime_error(std::strerror(errno));
+  }
+  FileProgress progress{};
+  bool matched = false;
+  try
+  {
+    matched = searchFd(patterns, scratch, fd, format, workers, progress, output);
+  }
+  catch (...)
+  {
+    if (!from_stdin)
+    {
+      ::close(fd);
+    }
+    if (summary)
+    {
+      writeFileSummary(format, progress.matching_lines > 0, progress, output);      // what was read before the error
+    }
+    throw;
+  }
+  if (!from_stdin)
+  {
+    ::close(fd);
+  }
+  if (summary)
+  {
+    writeFileSummary(format, matched, progress, output);
+  }
+  return InputResult{ matched, progress.binary_matched };
+}
+
+// GNU grep's note, on stderr, for a binary input that matched.
+static void reportBinaryMatch(const std::string& input)
+{
+  std::cerr << "grep: " << (input == "-" ? "(standard input)" : input) << ": binary file matches" << std::endl;
+}
+
+
+// Expands directory operands (with -r) into the regular files below them, sorted so runs are repeatable.
+static std::vector<std::string> collectInputs(const GrepOptions& options, std::vector<std::string>& errors)
+{
+  std::vector<std::string> inputs{};
+  for (const auto& file : options.files)
+  {
+    std::error_code error{};
+    if (file == "-" || !std::filesystem::is_directory(file, error))
+    {
+      inputs.push_back(file);
+      continue;
+    }
+    if (!options.recursive)
+    {
+      errors.push_back(file + ": Is a directory");
+      continue;
+    }
+
+    std::vector<std::string> found{};
+    for (auto it = std::filesystem::recursive_directory_iterator(file, std::filesystem::directory_options::skip_permission_denied, error);
+      !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+      if (it->is_regular_file(error))
+      {
+        found.push_back(it->path().string());
+      }
+    }
+    if (error)
+    {
+      errors.push_back(file + ": " + error.message());
+    }
+    std::sort(found.begin(), found.end());
+    inputs.insert(inputs.end(), found.begin(), found.end());
+  }
+  return inputs;
+}
+
+static void prepareWorkerScratch(MatchScratch& scratch, const PatternSet& patterns, size_t pattern_count, const GrepOptions& options)
+{
+  prepareMatchScratch(scratch, patterns);
+  scratch.step_budget = options.match_budget;
+  scratch.stats.pattern_lines.assign(pattern_count, 0);
+}
+
+// Lines whose search ran out of --match-budget were skipped; say so, since the output may be incomplete.
+static bool reportBudgetExceeded(const std::vector<MatchScratch>& scratches)
+{
+  std::uint64_t exceeded = 0;
+  for (const auto& scratch : scratches)
+  {
+    exceeded += scratch.budget_exceeded;
+  }
+  if (exceeded != 0)
+  {
+    std::cerr << "grep: match budget exceeded on " << exceeded << (exceeded == 1 ? " line" : " lines") << std::endl;
+  }
+  return exceeded != 0;
+}
+
+static void writeJsonString(std::ostream& stream, std::string_view text)
+{
+  static constexpr char hex[] = "0123456789abcdef";
+  stream << '"';
+  for (unsigned char c : text)
+  {
+    if (c == '"' || c == '\\')
+    {
+      stream << '\\' << c;
+    }
+    else if (c < 0x20)
+    {
+      stream << "\\u00" << hex[c >> 4] << hex[c & 15];
+    }
+    else
+    {
+      stream << c;
+    }
+  }
+  stream << '"';
+}
+
+// --stats: every worker's counters merged into one JSON object on stderr. Times are summed over
+// workers, so with -j they can exceed the wall clock.
+static void reportStats(const std::vector<MatchScratch>& scratches, const GrepOptions& options)
+{
+  if constexpr (!statsEnabled)
+  {
+    std::cerr << "grep: --stats: counters are not compiled in; configure with -DGREP_STATS=ON" << std::endl;
+    return;
+  }
+
+  SearchStats total{};
+  for (const auto& scratch : scratches)
+  {
+    total.merge(scratch.stats);
+  }
+  auto milliseconds = [](std::chrono::nanoseconds time) { return std::chrono::duration<double, std::milli>(time).count(); };
+  const double hit_rate = total.candidate_lines == 0 ? 0.0
+    : static_cast<double>(total.matching_lines) / static_cast<double>(total.candidate_lines);
+
+  std::ostringstream json{};
+  json << "{\"bytes_scanned\":" << total.bytes_scanned
+    << ",\"candidate_lines\":" << total.candidate_lines
+    << ",\"matching_lines\":" << total.matching_lines
+    << ",\"prefilter_hit_rate\":" << hit_rate
+    << ",\"prefilter_rejects\":" << total.prefilter_rejects
+    << ",\"start_offsets\":" << total.start_offsets
+    << ",\"pike_vm_threads\":" << total.pike_vm_threads
+    << ",\"counted_fallbacks\":" << total.counted_fallbacks
+    << ",\"backtrack_steps\":" << total.backtrack_steps
+    << ",\"max_backtrack_depth\":" << total.max_backtrack_depth
+    << ",\"capture_saves\":" << total.capture_saves
+    << ",\"time_ms\":{\"io\":" << milliseconds(total.io_time)
+    << ",\"prefilter\":" << milliseconds(total.prefilter_time)
+    << ",\"engine\":" << milliseconds(total.engine_time) << "}"
+    << ",\"patterns\":[";
+  for (size_t i = 0; i < options.patterns.size(); ++i)
+  {
+    json << (i == 0 ? "" : ",") << "{\"id\":" << i + 1 << ",\"pattern\":";
+    writeJsonString(json, options.patterns[i]);
+    json << ",\"matching_lines\":" << (i < total.pattern_lines.size() ? total.pattern_lines[i] : 0) << "}";
+  }
+  json << "]}\n";
+  std::cerr << json.str() << std::flush;
+}
+
+// Answers the requests of one --daemon client until it hangs up (protocol in cli.hpp).
+static void serveClient(Searcher& searcher, MatchScratch& scratch, int client, const GrepOptions& options)
+{
+  LineReader reader(client);
+  OutputWriter output(client);
+  std::string_view block{};
+  while (reader.nextBlock(block))
+  {
+    while (!block.empty())
+    {
+      auto line_end = block.find('\n');
+      auto request = block.substr(0, line_end);
+      block.remove_prefix(line_end == std::string_view::npos ? block.size() : line_end + 1);
+
+      std::string status{};
+      auto tab = request.find('\t');
+      try
+      {
+        if (tab == std::string_view::npos || tab == 0)
+        {
+          throw std::runtime_error("malformed request: expected PATH<TAB>PATTERN");
+        }
+        std::string path(request.substr(0, tab));
+        if (path == "-")
+        {
+          throw std::runtime_error("standard input is not available to the daemon");
+        }
+        auto patterns = searcher.patternSet({ std::string(request.substr(tab + 1)) }, options.ignore_case);
+        prepareWorkerScratch(scratch, *patterns, 1, options);
+        auto result = searchPath(*patterns, scratch, path, options, false, nullptr, output);
+        status = result.binary ? "0 binary file matches" : result.matched ? "0" : "1";
+      }
+      catch (const std::exception& e)
+      {
+        status = std::string("2 ") + e.what();
+      }
+      output.put('\0');
+      output.write(status);
+      output.put('\n');
+      output.flush();
+    }
+  }
+}
+
+// --daemon: accepts clients on a Unix socket and serves each on a worker of the pool. All of them share
+// one Searcher, so a pattern is compiled once however many requests and clients use it.
+static int runDaemon(const GrepOptions& options)
+{
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (options.daemon_socket.size() >= sizeof(address.sun_path))
+  {
+    throw std::runtime_error(options.daemon_socket + ": socket path too long");
+  }
+  std::copy(options.daemon_socket.begin(), options.daemon_socket.end(), address.sun_path);
+
+  int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0)
+  {
+    throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+  }
+  struct stat existing{};
+  if (::lstat(options.daemon_socket.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+  {
+    ::unlink(options.daemon_socket.c_str());       // left behind by an earlier run
+  }
+  if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0)
+  {
+    int error = errno;
+    ::close(listener);
+    throw std::runtime_error(options.daemon_socket + ": " + std::strerror(error));
+  }
+  std::signal(SIGPIPE, SIG_IGN);                    // a client hanging up must not take the server down
+
+  Searcher searcher{};
+  unsigned jobs = options.jobs != 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+  std::vector<MatchScratch> scratches(jobs);
+  ThreadPool pool(jobs);
+  while (true)
+  {
+    int client = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+      {
+        continue;
+      }
+      throw std::runtime_error(std::string("accept: ") + std::strerror(errno));
+    }
+    pool.submit([&, client](size_t worker)
+      {
+        try
+        {
+          serveClient(searcher, scratches[worker], client, options);
+        }
+        catch (const std::exception&)
+        {
+          // The client went away mid-answer; nothing is left to tell it.
+        }
+        ::close(client);
+      });
+  }
+}
+
+int runGrep(int argc, char* argv[])
+{
+  auto options = parseArguments(argc, argv);
+  if (!options.daemon_socket.empty())
+  {
+    return runDaemon(options);
+  }
+  auto patterns = compilePatternSet(options.patterns, options.ignore_case);
+
+  if (options.files.empty())
+  {
+    options.files.emplace_back(options.recursive ? "." : "-");
+  }
+  const bool show_names = options.recursive || options.files.size() > 1;
+
+  std::vector<std::string> errors{};
+  auto inputs = collectInputs(options, errors);
+  bool failed = !errors.empty();
+  for (const auto& error : errors)
+  {
+    std::cerr << "grep: " << error << std::endl;
+  }
+
+  OutputWriter output(STDOUT_FILENO);
+  bool matched = false;
+  // Groups of context lines are separated by "--" across files too.
+  const bool context = options.context && !options.count_only && !options.files_with_matches;
+  bool printed_group = false;
+  unsigned jobs = options.jobs != 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+
+  if (jobs <= 1 || inputs.size() <= 1)
+  {
+    // A lone input runs on this thread; the pool only splits it if it is a large regular file.
+    MatchScratch scratch{};
+    prepareWorkerScratch(scratch, patterns, options.patterns.size(), options);
+    std::unique_ptr<ThreadPool> pool{};
+    std::vector<MatchScratch> scratches{};
+    std::unique_ptr<ChunkWorkers> workers{};
+    if (jobs > 1)
+    {
+      pool = std::make_unique<ThreadPool>(jobs);
+      scratches.resize(pool->size());
+      for (auto& worker_scratch : scratches)
+      {
+        prepareWorkerScratch(worker_scratch, patterns, options.patterns.size(), options);
+      }
+      workers = std::make_unique<ChunkWorkers>(ChunkWorkers{ *pool, scratches });
+    }
+
+    for (const auto& input : inputs)
+    {
+      try
+      {
+        auto result = searchPath(patterns, scratch, input, options, show_names, workers.get(), output, printed_group);
+        matched |= result.matched;
+        printed_group |= context && result.matched && !result.binary;
+        if (result.binary)
+        {
+          output.flush();
+          reportBinaryMatch(input);
+        }
+      }
+      catch (const std::exception& e)
+      {
+        output.flush();
+        std::cerr << "grep: " << input << ": " << e.what() << std::endl;
+        failed = true;
+      }
+    }
+    pool.reset();
+    scratches.push_back(std::move(scratch));
+    failed |= reportBudgetExceeded(scratches);
+    output.flush();
+    if (options.stats)
+    {
+      reportStats(scratches, options);
+    }
+    return failed ? exitError : matched ? exitMatch : exitNoMatch;
+  }
+
+  // One task per file. Each file's output is buffered and printed in input order, or as soon as the
+  // file is done with --no-sort.
+  struct FileResult
+  {
+    BufferOutput output{};
+    std::string error{};
+    InputResult found{};
+    bool done{ false };
+  };
+  std::vector<FileResult> results(inputs.size());
+  std::mutex results_mutex{};
+  std::condition_variable result_ready{};
+
+  auto report = [&](FileResult& result, const std::string& input)
+    {
+      if (context && !result.output.text.empty())
+      {
+        if (printed_group)
+        {
+          writeGroupSeparator(options.color, output);
+        }
+        printed_group = true;
+      }
+      output.write(result.output.text);
+      if (result.found.binary)
+      {
+        output.flush();
+        reportBinaryMatch(input);
+      }
+      if (!result.error.empty())
+      {
+        output.flush();
+        std::cerr << "grep: " << input << ": " << result.error << std::endl;
+        failed = true;
+      }
+      matched |= result.found.matched;
+      result.output.text = std::string{};
+    };
+
+  std::vector<MatchScratch> scratches(std::min<size_t>(jobs, inputs.size()));
+  for (auto& worker_scratch : scratches)
+  {
+    prepareWorkerScratch(worker_scratch, patterns, options.patterns.size(), options);
+  }
+  {
+    ThreadPool pool(scratches.size());
+
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+      pool.submit([&, i](size_t worker)
+        {
+          auto& result = results[i];
+          try
+          {
+            result.found = searchPath(patterns, scratches[worker], inputs[i], options, show_names, nullptr, result.output);
+          }
+          catch (const std::exception& e)
+          {
+            result.error = e.what();
+          }
+
+          std::lock_guard lock(results_mutex);
+          result.done = true;
+          if (!options.sort_output)
+          {
+            report(result, inputs[i]);
+          }
+          result_ready.notify_all();
+        });
+    }
+
+    if (options.sort_output)
+    {
+      for (size_t i = 0; i < inputs.size(); ++i)
+      {
+        std::unique_lock lock(results_mutex);
+        result_ready.wait(lock, [&] { return results[i].done; });
+        report(results[i], inputs[i]);
+      }
+    }
+  }
+
+  failed |= reportBudgetExceeded(scratches);
+  output.flush();
+  if (options.stats)
+  {
+    reportStats(scratches, options);
+  }
+  return failed ? exitError : matched ? exitMatch : exitNoMatch;
+}
+
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    return runGrep(argc, argv);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "grep: " << e.what() << std::endl;
+    return 2;
+  }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct GrepOptions
+{
+  std::vector<std::string> patterns{};    // the PATTERN operand, or every -e and -f pattern in order
+  std::vector<std::string> files{};       // empty or "-" means standard input
+  bool recursive{ false };                // -r: search directories
+  bool ignore_case{ false };              // -i: letters match either case
+  bool line_numbers{ false };             // -n: prefix lines with their number
+  bool only_matching{ false };            // -o: print each match on its own line instead of the line
+  bool byte_offsets{ false };             // -b: prefix with the byte offset of the line (of the match with -o)
+  bool count_only{ false };               // -c: print the number of matching lines of each file instead of the lines
+  bool files_with_matches{ false };       // -l: print only the names of files with a matching line
+  bool binary_text{ false };              // -a: print matches in files with NUL bytes like any others
+  std::uint64_t before_context{ 0 };      // -B N (or -C N): lines to print before each matching line
+  std::uint64_t after_context{ 0 };       // -A N (or -C N): lines to print after each matching line
+  bool context{ false };                  // any of -A, -B, -C given, even as 0: "--" goes between groups of lines
+  bool color{ false };                    // --color[=WHEN]: highlight matches, file names and numbers
+  bool sort_output{ true };               // --no-sort clears it: print files as they finish
+  unsigned jobs{ 0 };                     // -j N: worker threads, 0 = one per hardware thread
+  std::uint64_t match_budget{ 0 };        // --match-budget N: backtracking steps per line, 0 = unlimited
+  bool pattern_ids{ false };              // --pattern-id: prefix lines with the number of the pattern that matched
+  bool stats{ false };                    // --stats: print search counters as JSON on stderr at exit
+  std::string daemon_socket{};            // --daemon SOCKET: serve search requests on this Unix socket
+};
+
+// Parses `grep -E [-r] [-i] [-n] [-o] [-b] [-c] [-l] [-a] [-A N] [-B N] [-C N] [--color[=WHEN]] [-j N] [--no-sort] [--match-budget N] [--pattern-id] [--stats] {PATTERN | -e PATTERN... | -f FILE...} [FILE...]`.
+// -e and -f may be repeated and mixed; patterns are numbered from 1 in the order given. -A and -B
+// override -C whatever their order, and -l takes precedence over -c.
+// `grep --daemon SOCKET [options]` takes no pattern: each request brings its own (see runGrep).
+// Throws std::runtime_error on a usage error.
+GrepOptions parseArguments(int argc, char* argv[]);
+
+// Runs a search and returns the grep exit status: 0 if a line matched, 1 if none did, 2 on error.
+// With --daemon it listens on the socket instead and serves requests until killed. A client sends
+// requests one per line, PATH, a tab, then PATTERN. Each is answered with what `grep [options] -e PATTERN
+// PATH` would print, then a status line: a NUL byte, the exit status and, for status 2, a space and the
+// error (for a binary file that matched: status 0, a space and "binary file matches"). Compiled patterns
+// are cached across requests and clients.
+int runGrep(int argc, char* argv[]);
@@ -0,0 +1,411 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "main.hpp"
+#include "syntax.hpp"
+
+// Pattern text -> instruction program. Everything here is constexpr, so compilePattern runs it at run
+// time and grepcpp::match (static_match.hpp) runs the very same code at compile time.
+
+// Repetitions of a single character up to this many copies are unrolled, which keeps every copy visible
+// to the prefilter (`a{3}` requires the literal `aaa`); longer ones become one Repeat instruction.
+inline constexpr int maxUnrolledRepeat = 16;
+// Other counted repetitions are unrolled copy by copy; one that would grow the program by more than this
+// is refused, so a pattern cannot make the compiler take unbounded memory.
+inline constexpr size_t maxRepetitionProgramSize = 1 << 18;
+
+constexpr int emit(CompiledPattern& compiled, Opcode op, char c = '\0', int x = 0, int y = 0, int z = 0)
+{
+  compiled.program.push_back(Instruction{ op, c, x, y, z });
+  return static_cast<int>(compiled.program.size()) - 1;
+}
+
+// A literal character; with ignore_case a letter becomes the class of both its cases.
+constexpr void emitChar(CompiledPattern& compiled, char c)
+{
+  if (compiled.ignore_case && toLowerAscii(c) >= 'a' && toLowerAscii(c) <= 'z')
+  {
+    compiled.classes.push_back(CharSet::single(c).foldCase());
+    emit(compiled, Opcode::Class, '\0', static_cast<int>(compiled.classes.size()) - 1);
+    return;
+  }
+  emit(compiled, Opcode::Char, c);
+}
+
+// The bytes of a `[...]` set; with ignore_case both cases of its letters, folded before any `^` negation
+// so that [^a] excludes `A` as well.
+constexpr CharSet bracketSet(std::string::const_iterator atom_start, std::string::const_iterator atom_end, bool ignore_case)
+{
+  bool isNegativeGroup = (atom_start + 1 != atom_end && *(atom_start + 1) == '^');
+  auto chars = charSetBuilder(atom_start + (isNegativeGroup ? 2 : 1), atom_end - 1);
+  if (ignore_case)
+  {
+    chars = chars.foldCase();
+  }
+  return isNegativeGroup ? chars.complement() : chars;
+}
+
+// With `reverse` set, every sequence is emitted right to left: the program then matches the reversed
+// language and is meant to be run backwards from the end of the text (see reversePikeVmSearch).
+constexpr void compileAlternation(CompiledPattern& compiled, std::string::const_iterator pattern_start, std::string::const_iterator pattern_end, int& next_group,
+  bool reverse = false);
+
+constexpr std::string::const_iterator findAtomEnd(std::string::const_iterator pattern_start, std::string::const_iterator pattern_end)
+{
+  if (*pattern_start == '[')
+  {
+    auto group_end = std::find(pattern_start, pattern_end, ']');
+    if (group_end == pattern_end)
+    {
+      throw std::runtime_error("Closing ']' not found");
+    }
+    return group_end + 1;
+  }
+  if (*pattern_start == '(')
+  {
+    return findClosingParenthesis(pattern_start, pattern_end) + 1;
+  }
+  if (*pattern_start == '\\')
+  {
+    return pattern_start + 1 == pattern_end ? pattern_end : pattern_start + 2;
+  }
+  return pattern_start + 1;
+}
+
+// Emits a single atom: a character, `.`, an escape, a `[...]` set, a `(...)` group or an anchor.
+constexpr void compileAtom(CompiledPattern& compiled, std::string::const_iterator atom_start, std::string::const_iterator atom_end, int& next_group,
+  bool reverse = false)
+{
+  switch (*atom_start)
+  {
+  case '^':
+    emit(compiled, Opcode::AssertBegin);
+    break;
+  case '$':
+    emit(compiled, Opcode::AssertEnd);
+    break;
+  case '.':
+    emit(compiled, Opcode::Any);
+    break;
+  case '[':
+    compiled.classes.push_back(bracketSet(atom_start, atom_end, compiled.ignore_case));
+    emit(compiled, Opcode::Class, '\0', static_cast<int>(compiled.classes.size()) - 1);
+    break;
+  case '(':
+  {
+    int group = next_group++;
+    emit(compiled, Opcode::Save, '\0', 2 * group);
+    compileAlternation(compiled, atom_start + 1, atom_end - 1, next_group, reverse);
+    emit(compiled, Opcode::Save, '\0', 2 * group + 1);
+    break;
+  }
+  case '\\':
+  {
+    if (atom_start + 1 == atom_end)
+    {
+      emit(compiled, Opcode::Fail);                   // dangling backslash
+      break;
+    }
+    int possibleBackRefIndex = (*(atom_start + 1) - '0');
+    if (possibleBackRefIndex >= 1 && possibleBackRefIndex <= 9 && possibleBackRefIndex <= next_group)
+    {
+      emit(compiled, Opcode::Backref, '\0', possibleBackRefIndex - 1);
+      compiled.has_backreferences = true;
+    }
+    else if (isCharacterClass(*(atom_start + 1)))
+    {
+      compiled.classes.push_back(characterClassSelector(*(atom_start + 1)));
+      emit(compiled, Opcode::Class, '\0', static_cast<int>(compiled.classes.size()) - 1);
+    }
+    else
+    {
+      emitChar(compiled, *(atom_start + 1));
+    }
+    break;
+  }
+  default:
+    emitChar(compiled, *atom_start);
+    break;
+  }
+}
+
+// Reports whether the atom always consumes exactly one character, and which ones.
+constexpr bool singleCharacterAtom(std::string::const_iterator atom_start, std::string::const_iterator atom_end, int next_group, bool ignore_case,
+  CharSet& chars)
+{
+  switch (*atom_start)
+  {
+  case '^':
+  case '$':
+  case '(':
+    return false;
+  case '.':
+    chars = anyCharSet;
+    return true;
+  case '[':
+    chars = bracketSet(atom_start, atom_end, ignore_case);
+    return true;
+  case '\\':
+  {
+    if (atom_start + 1 == atom_end)
+    {
+      return false;
+    }
+    int possibleBackRefIndex = (*(atom_start + 1) - '0');
+    if (possibleBackRefIndex >= 1 && possibleBackRefIndex <= 9 && possibleBackRefIndex <= next_group)
+    {
+      return false;
+    }
+    chars = isCharacterClass(*(atom_start + 1)) ? characterClassSelector(*(atom_start + 1)) : CharSet::single(*(atom_start + 1));
+    chars = ignore_case ? chars.foldCase() : chars;
+    return true;
+  }
+  default:
+    chars = ignore_case ? CharSet::single(*atom_start).foldCase() : CharSet::single(*atom_start);
+    return true;
+  }
+}
+
+// Whether the code in [start_pc, end_pc) can run from start to end without consuming a character.
+// Back references count as empty since the group they repeat may have captured nothing.
+constexpr bool matchesEmpty(const CompiledPattern& compiled, int start_pc, int end_pc)
+{
+  std::vector<char> seen(end_pc - start_pc + 1, 0);
+  std::vector<int> pending{ start_pc };
+  while (!pending.empty())
+  {
+    int pc = pending.back();
+    pending.pop_back();
+    if (pc == end_pc)
+    {
+      return true;
+    }
+    if (pc < start_pc || pc > end_pc || seen[pc - start_pc])
+    {
+      continue;
+    }
+    seen[pc - start_pc] = 1;
+
+    const auto& instruction = compiled.program[pc];
+    switch (instruction.op)
+    {
+    case Opcode::Split:
+      pending.push_back(instruction.x);
+      pending.push_back(instruction.y);
+      break;
+    case Opcode::Jump:
+      pending.push_back(instruction.x);
+      break;
+    case Opcode::Repeat:
+      if (instruction.y == 0)
+      {
+        pending.push_back(pc + 1);
+      }
+      break;
+    case Opcode::Char:
+    case Opcode::Class:
+    case Opcode::Any:
+    case Opcode::Fail:
+    case Opcode::Match:
+      break;
+    default:                                        // Star, Save, Progress, Backref, assertions
+      pending.push_back(pc + 1);
+      break;
+    }
+  }
+  return false;
+}
+
+// Emits `min` mandatory copies of the atom followed by either a greedy loop (max == -1) or `max - min` optional copies;
+// long counts of a single character become one Repeat instead.
+constexpr void compileRepetition(CompiledPattern& compiled, std::string::const_iterator atom_start, std::string::const_iterator atom_end,
+  int min, int max, int& next_group, bool reverse = false)
+{
+  const int group_base = next_group;          // every copy of a group captures into the same slots
+  const size_t program_start = compiled.program.size();
+  auto emitCopy = [&]()
+    {
+      next_group = group_base;
+      compileAtom(compiled, atom_start, atom_end, next_group, reverse);
+      if (compiled.program.size() - program_start > maxRepetitionProgramSize)
+      {
+        throw std::runtime_error("Regular expression too big");
+      }
+    };
+
+  // A long count of one character: a single Repeat (then a Star for `{n,}`) instead of a copy per count.
+  CharSet chars{};
+  if (std::max(min, max) > maxUnrolledRepeat && singleCharacterAtom(atom_start, atom_end, next_group, compiled.ignore_case, chars))
+  {
+    compiled.classes.push_back(chars);
+    const int chars_index = static_cast<int>(compiled.classes.size()) - 1;
+    if (min > 0 || max != -1)
+    {
+      emit(compiled, Opcode::Repeat, '\0', chars_index, min, max == -1 ? min : max);
+    }
+    if (max == -1)
+    {
+      emit(compiled, Opcode::Star, '\0', chars_index);
+    }
+    return;
+  }
+
+  for (int i = 0; i < min; ++i)
+  {
+    emitCopy();
+  }
+
+  if (max == -1 && singleCharacterAtom(atom_start, atom_end, next_group, compiled.ignore_case, chars))
+  {
+    compiled.classes.push_back(chars);
+    emit(compiled, Opcode::Star, '\0', static_cast<int>(compiled.classes.size()) - 1);
+    return;
+  }
+
+  if (max == -1)
+  {
+    // A group or back reference may match the empty string; guard the loop so it cannot spin in place.
+    bool canMatchEmpty = (*atom_start == '(' || *atom_start == '\\');
+    int guard = canMatchEmpty ? -(++compiled.slot_count) : 0;     // resolved to a real slot once the group count is known
+
+    int loop = emit(compiled, Opcode::Split);
+    compiled.program[loop].x = loop + 1;
+    int guard_save = canMatchEmpty ? emit(compiled, Opcode::Save, '\0', guard) : -1;
+    emitCopy();
+    if (canMatchEmpty && !matchesEmpty(compiled, guard_save + 1, static_cast<int>(compiled.program.size())))
+    {
+      // Every pass consumes text after all: drop the guard (its slot stays unused) so that the loop
+      // body keeps its backtracker memo rows.
+      compiled.program[guard_save] = Instruction{ Opcode::Jump, '\0', guard_save + 1 };
+      canMatchEmpty = false;
+    }
+    if (canMatchEmpty)
+    {
+      emit(compiled, Opcode::Progress, '\0', guard);
+    }
+    emit(compiled, Opcode::Jump, '\0', loop);
+    compiled.program[loop].y = static_cast<int>(compiled.program.size());
+    return;
+  }
+
+  std::vector<int> exits{};
+  for (int i = min; i < max; ++i)
+  {
+    int split = emit(compiled, Opcode::Split);
+    compiled.program[split].x = split + 1;
+    exits.push_back(split);
+    emitCopy();
+  }
+  for (int exit : exits)
+  {
+    compiled.program[exit].y = static_cast<int>(compiled.program.size());
+  }
+}
+
+constexpr void compileSequence(CompiledPattern& compiled, std::string::const_iterator pattern_start, std::string::const_iterator pattern_end, int& next_group,
+  bool reverse = false)
+{
+  while (pattern_start != pattern_end)
+  {
+    if (isQuantifierAdvanced(*pattern_start))
+    {
+      emit(compiled, Opcode::Fail);                   // invalid target for quantifier
+      return;
+    }
+
+    auto atom_end = findAtomEnd(pattern_start, pattern_end);
+    if (atom_end == pattern_end || !isQuantifierAdvanced(*atom_end))
+    {
+      if (reverse)
+      {
+        compileSequence(compiled, atom_end, pattern_end, next_group, true);    // everything after this atom comes first
+      }
+      compileAtom(compiled, pattern_start, atom_end, next_group, reverse);
+      if (reverse)
+      {
+        return;
+      }
+      pattern_start = atom_end;
+      continue;
+    }
+
+    if (*pattern_start == '^' || *pattern_start == '$')
+    {
+      emit(compiled, Opcode::Fail);                   // quantified anchor
+      return;
+    }
+
+    int min{};
+    int max{};
+    auto next_start = atom_end + 1;
+    switch (*atom_end)
+    {
+    case '*':
+      min = 0;
+      max = -1;                                       // -1 == infinite
+      break;
+    case '+':
+      min = 1;
+      max = -1;
+      break;
+    case '?':
+      min = 0;
+      max = 1;
+      break;
+    default:
+      next_start = parseQuantifierRange(min, max, atom_end + 1, pattern_end);       // handle custom quantifier {n, m} | {n} | {n,}
+      break;
+    }
+
+    if (reverse)
+    {
+      compileSequence(compiled, next_start, pattern_end, next_group, true);
+    }
+    compileRepetition(compiled, pattern_start, atom_end, min, max, next_group, reverse);
+    if (reverse)
+    {
+      return;
+    }
+    pattern_start = next_start;
+  }
+}
+
+constexpr void compileAlternation(CompiledPattern& compiled, std::string::const_iterator pattern_start, std::string::const_iterator pattern_end, int& next_group,
+  bool reverse)
+{
+  auto orPosition = findOutermostOr(pattern_start, pattern_end);
+  if (orPosition == pattern_end)
+  {
+    compileSequence(compiled, pattern_start, pattern_end, next_group, reverse);
+    return;
+  }
+
+  int split = emit(compiled, Opcode::Split);
+  compiled.program[split].x = split + 1;
+  compileSequence(compiled, pattern_start, orPosition, next_group, reverse);
+  int jump = emit(compiled, Opcode::Jump);
+  compiled.program[split].y = static_cast<int>(compiled.program.size());
+  compileAlternation(compiled, orPosition + 1, pattern_end, next_group, reverse);
+  compiled.program[jump].x = static_cast<int>(compiled.program.size());
+}
+
+// Loop guards were numbered -1, -2, ... while the group count was still unknown.
+constexpr void resolveLoopGuards(CompiledPattern& compiled, int group_count)
+{
+  compiled.group_count = group_count;
+  for (auto& instruction : compiled.program)
+  {
+    if ((instruction.op == Opcode::Save || instruction.op == Opcode::Progress) && instruction.x < 0)
+    {
+      instruction.x = 2 * compiled.group_count - instruction.x - 1;
+    }
+    if (instruction.op == Opcode::Repeat)
+    {
+      compiled.counted_threads += static_cast<size_t>(instruction.z);
+    }
+  }
+  compiled.slot_count += 2 * compiled.group_count;
+  compiled.anchored_begin = compiled.program.front().op == Opcode::AssertBegin;
+}
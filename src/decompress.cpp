@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <stdexcept>
+
+#ifdef GREP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef GREP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "decompress.hpp"
+#include "simd_scan.hpp"
+
+
+#ifdef GREP_HAVE_ZLIB
+static constexpr std::string_view gzipMagic = "\x1f\x8b";
+#endif
+#ifdef GREP_HAVE_ZSTD
+static constexpr std::string_view zstdMagic = "\x28\xb5\x2f\xfd";
+#endif
+
+Compression detectCompression(std::string_view header)
+{
+#ifdef GREP_HAVE_ZLIB
+  if (header.starts_with(gzipMagic))
+  {
+    return Compression::Gzip;
+  }
+#endif
+#ifdef GREP_HAVE_ZSTD
+  if (header.starts_with(zstdMagic))
+  {
+    return Compression::Zstd;
+  }
+#endif
+  (void)header;
+  return Compression::None;
+}
+
+// Turns the whole compressed input into plain bytes, a piece at a time.
+class Decoder
+{
+public:
+  virtual ~Decoder() = default;
+
+  // Writes up to `capacity` bytes to `out`; 0 means the stream is over. Throws std::runtime_error on bad data.
+  virtual size_t read(char* out, size_t capacity) = 0;
+};
+
+#ifdef GREP_HAVE_ZLIB
+// gzip, including files made of several concatenated members (as `cat a.gz b.gz` produces).
+class GzipDecoder : public Decoder
+{
+public:
+  explicit GzipDecoder(std::string_view input)
+    : input_(input)
+  {
+    if (inflateInit2(&stream_, 15 + 16) != Z_OK)         // 15-bit window, gzip wrapper
+    {
+      throw std::runtime_error("cannot initialize zlib");
+    }
+  }
+
+  ~GzipDecoder() override { inflateEnd(&stream_); }
+
+  size_t read(char* out, size_t capacity) override
+  {
+    stream_.next_out = reinterpret_cast<Bytef*>(out);
+    stream_.avail_out = static_cast<uInt>(std::min<size_t>(capacity, UINT_MAX));
+    const uInt requested = stream_.avail_out;
+
+    if (!error_.empty())
+    {
+      throw std::runtime_error(error_);
+    }
+    while (!done_ && stream_.avail_out > 0)
+    {
+      if (stream_.avail_in == 0)
+      {
+        // zlib counts input in uInt, so inputs over 4 GiB are fed in slices.
+        const size_t slice = std::min<size_t>(input_.size(), UINT_MAX);
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input_.data()));
+        stream_.avail_in = static_cast<uInt>(slice);
+        input_.remove_prefix(slice);
+      }
+
+      int status = inflate(&stream_, Z_NO_FLUSH);
+      if (status == Z_STREAM_END)
+      {
+        // Another member may follow; anything else after the last one (padding) is ignored, as gzip does.
+        auto rest = std::string_view(reinterpret_cast<const char*>(stream_.next_in), stream_.avail_in);
+        done_ = !(rest.starts_with(gzipMagic) || (rest.empty() && input_.starts_with(gzipMagic)));
+        if (!done_)
+        {
+          inflateReset(&stream_);
+        }
+      }
+      else if (status == Z_BUF_ERROR && stream_.avail_in == 0 && input_.empty())
+      {
+        error_ = "unexpected end of compressed data";
+      }
+      else if (status != Z_OK && status != Z_BUF_ERROR)
+      {
+        error_ = std::string("invalid compressed data: ") + (stream_.msg != nullptr ? stream_.msg : "zlib error");
+      }
+      if (!error_.empty())
+      {
+        // Output decoded before the damage still goes out; the error comes with the next call.
+        if (stream_.avail_out != requested)
+        {
+          break;
+        }
+        throw std::runtime_error(error_);
+      }
+    }
+    return requested - stream_.avail_out;
+  }
+
+private:
+  z_stream stream_{};
+  std::string_view input_;                        // not yet handed to zlib
+  std::string error_{};
+  bool done_{ false };
+};
+#endif
+
+#ifdef GREP_HAVE_ZSTD
+// zstd, including files of several frames; the streaming decoder moves from one frame to the next by itself.
+class ZstdDecoder : public Decoder
+{
+public:
+  explicit ZstdDecoder(std::string_view input)
+    : stream_(ZSTD_createDStream()), input_{ input.data(), input.size(), 0 }
+  {
+    if (stream_ == nullptr)
+    {
+      throw std::runtime_error("cannot initialize zstd");
+    }
+  }
+
+  ~ZstdDecoder() override { ZSTD_freeDStream(stream_); }
+
+  size_t read(char* out, size_t capacity) override
+  {
+    ZSTD_outBuffer output{ out, capacity, 0 };
+    while (output.pos == 0)
+    {
+      // Between frames, the input may end; zero bytes after the last frame (padding) are ignored, as for gzip.
+      const char* rest = static_cast<const char*>(input_.src) + input_.pos;
+      if (frame_ended_ && std::all_of(rest, static_cast<const char*>(input_.src) + input_.size, [](char c) { return c == '\0'; }))
+      {
+        break;
+      }
+      const size_t consumed = input_.pos;
+      const size_t hint = ZSTD_decompressStream(stream_, &output, &input_);
+      if (ZSTD_isError(hint))
+      {
+        throw std::runtime_error(std::string("invalid compressed data: ") + ZSTD_getErrorName(hint));
+      }
+      frame_ended_ = hint == 0;                   // the frame is decoded and flushed
+      if (output.pos == 0 && input_.pos == consumed && !frame_ended_)
+      {
+        throw std::runtime_error("unexpected end of compressed data");        // a frame is still open
+      }
+    }
+    return output.pos;
+  }
+
+private:
+  ZSTD_DStream* stream_;
+  ZSTD_inBuffer input_;
+  bool frame_ended_{ false };
+};
+#endif
+
+static std::unique_ptr<Decoder> makeDecoder(Compression compression, std::string_view input)
+{
+  switch (compression)
+  {
+#ifdef GREP_HAVE_ZLIB
+  case Compression::Gzip:
+    return std::make_unique<GzipDecoder>(input);
+#endif
+#ifdef GREP_HAVE_ZSTD
+  case Compression::Zstd:
+    return std::make_unique<ZstdDecoder>(input);
+#endif
+  default:
+    throw std::runtime_error("compression format not supported by this build");
+  }
+}
+
+
+DecompressedBlocks::DecompressedBlocks(std::string_view input, Compression compression, LongLines long_lines, size_t block_size,
+  size_t ring_size)
+  : input_(input), compression_(compression), long_lines_(long_lines), buffers_(std::max<size_t>(ring_size, 2), std::vector<char>(block_size))
+{
+  for (size_t i = 0; i < buffers_.size(); ++i)
+  {
+    free_.push_back(i);
+  }
+  thread_ = std::thread([this] { produce(); });
+}
+
+DecompressedBlocks::~DecompressedBlocks()
+{
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+}
+
+size_t DecompressedBlocks::takeFreeBuffer()
+{
+  std::unique_lock lock(mutex_);
+  changed_.wait(lock, [&] { return !free_.empty() || stopping_; });
+  if (stopping_)
+  {
+    return buffers_.size();
+  }
+  size_t buffer = free_.front();
+  free_.pop_front();
+  return buffer;
+}
+
+void DecompressedBlocks::pushBlock(size_t buffer, size_t size, bool partial)
+{
+  {
+    std::lock_guard lock(mutex_);
+    filled_.push_back(Filled{ buffer, size, partial });
+  }
+  changed_.notify_all();
+}
+
+// Fills one free buffer after another. Each block ends at its last '\n'; the unfinished line after it
+// is carried to the front of the next buffer, and a buffer only grows when a single line fills it (or,
+// if long_lines_ says so, goes out whole as a partial block).
+void DecompressedBlocks::produce()
+{
+  try
+  {
+    auto decoder = makeDecoder(compression_, input_);
+    std::vector<char> carry{};
+    bool at_end = false;
+    while (!at_end)
+    {
+      const size_t buffer = takeFreeBuffer();
+      if (buffer == buffers_.size())
+      {
+        return;
+      }
+      auto& data = buffers_[buffer];
+      if (data.size() <= carry.size())
+      {
+        data.resize(2 * carry.size());
+      }
+      std::copy(carry.begin(), carry.end(), data.begin());
+      size_t used = carry.size();
+      bool partial = false;
+
+      while (used < data.size() && !at_end)
+      {
+        size_t produced = 0;
+        try
+        {
+          produced = decoder->read(data.data() + used, data.size() - used);
+        }
+        catch (const std::exception& e)
+        {
+          // What was decoded before the damage is still searched, as zcat would print it.
+          std::lock_guard lock(mutex_);
+          error_ = e.what();
+        }
+        at_end = produced == 0;
+        used += produced;
+        if (used == data.size() && findByte(data.data(), data.data() + used, '\n') == nullptr)
+        {
+          if (splitLongLine(long_lines_, data.data(), data.data() + used))
+          {
+            partial = true;
+            break;
+          }
+          data.resize(2 * data.size());
+        }
+      }
+
+      size_t block_size = used;
+      if (!at_end && !partial)
+      {
+        block_size = static_cast<size_t>(findLastByte(data.data(), data.data() + used, '\n') + 1 - data.data());
+      }
+      carry.assign(data.data() + block_size, data.data() + used);
+      if (block_size == 0)
+      {
+        std::lock_guard lock(mutex_);
+        free_.push_back(buffer);
+        continue;
+      }
+      pushBlock(buffer, block_size, partial);
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::lock_guard lock(mutex_);
+    error_ = e.what();
+  }
+
+  {
+    std::lock_guard lock(mutex_);
+    finished_ = true;
+  }
+  changed_.notify_all();
+}
+
+bool DecompressedBlocks::nextBlock(std::string_view& block)
+{
+  std::unique_lock lock(mutex_);
+  if (holding_)
+  {
+    free_.push_back(in_use_);                     // the caller is done with the previous block
+    holding_ = false;
+    changed_.notify_all();
+  }
+  changed_.wait(lock, [&] { return !filled_.empty() || finished_; });
+
+  if (!filled_.empty())
+  {
+    const auto filled = filled_.front();
+    filled_.pop_front();
+    in_use_ = filled.buffer;
+    holding_ = true;
+    partial_ = filled.partial;
+    block = std::string_view(buffers_[filled.buffer].data(), filled.size);
+    return true;
+  }
+  if (!error_.empty())
+  {
+    throw std::runtime_error(error_);
+  }
+  return false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "io.hpp"
+
+enum class Compression
+{
+  None,
+  Gzip,
+  Zstd,
+};
+
+// Recognizes gzip and zstd data by their magic bytes. Formats this build has no decoder for (see
+// GREP_HAVE_ZLIB / GREP_HAVE_ZSTD) report None, so such files are searched as they are.
+Compression detectCompression(std::string_view header);
+
+// Decompresses `input` on a thread of its own into a small ring of reusable buffers, so that inflating
+// the next block overlaps with searching the current one. Blocks are handed out the way LineReader does
+// it: runs of whole lines, each keeping its '\n', and lines too long for a buffer grown or split as
+// `long_lines` says. A view stays valid until the next call to `nextBlock`. Corrupt or truncated input
+// surfaces as std::runtime_error from `nextBlock`.
+class DecompressedBlocks
+{
+public:
+  DecompressedBlocks(std::string_view input, Compression compression, LongLines long_lines = LongLines::Grow,
+    size_t block_size = 1024 * 1024, size_t ring_size = 4);
+  ~DecompressedBlocks();                          // stops the decompressor early if the search gave up
+
+  DecompressedBlocks(const DecompressedBlocks&) = delete;
+  DecompressedBlocks& operator=(const DecompressedBlocks&) = delete;
+
+  bool nextBlock(std::string_view& block);
+  // The block last handed out is a piece of a line that the next block continues.
+  bool partial() const { return partial_; }
+
+private:
+  struct Filled
+  {
+    size_t buffer{};
+    size_t size{};
+    bool partial{ false };
+  };
+
+  void produce();
+  void pushBlock(size_t buffer, size_t size, bool partial);
+  size_t takeFreeBuffer();
+
+  std::string_view input_;
+  Compression compression_;
+  LongLines long_lines_;                          // read and updated by the decompressor thread only
+  std::vector<std::vector<char>> buffers_{};
+  std::deque<size_t> free_{};                    // buffers the decompressor may fill
+  std::deque<Filled> filled_{};                  // blocks waiting for the search, in stream order
+  size_t in_use_{};                               // buffer behind the block last handed out
+  bool holding_{ false };
+  bool partial_{ false };
+  bool finished_{ false };                        // the decompressor has pushed its last block
+  bool stopping_{ false };
+  std::string error_{};
+  std::mutex mutex_{};
+  std::condition_variable changed_{};
+  std::thread thread_{};
+};
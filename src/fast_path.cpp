@@ -0,0 +1,88 @@
+#include "fast_path.hpp"
+#include "prefilter.hpp"
+#include "simd_scan.hpp"
+
+
+FastPath classifyFastPath(const CompiledPattern& pattern)
+{
+  const auto& program = pattern.program;
+  const auto& prefilter = pattern.prefilter;
+  if (pattern.has_backreferences || pattern.anchored_end || program.size() < 2)
+  {
+    return FastPath::None;
+  }
+
+  // Literal bytes, optionally after `^`, straight into Match. Their prefilter literal is all of them.
+  const size_t literal_start = program.front().op == Opcode::AssertBegin ? 1 : 0;
+  size_t pc = literal_start;
+  char c{};
+  while (pc + 1 < program.size() && literalByte(pattern, program[pc], c))
+  {
+    ++pc;
+  }
+  if (pc + 1 == program.size() && pc > literal_start && prefilter.literal.size() == pc - literal_start)
+  {
+    return literal_start == 0 ? FastPath::Literal : FastPath::AnchoredLiteral;
+  }
+
+  // One character of a set, then a Star over the same set: the prefilter's first bytes are that set.
+  if (program.size() == 3 && (program[0].op == Opcode::Char || program[0].op == Opcode::Class) && program[1].op == Opcode::Star
+    && prefilter.has_first_chars)
+  {
+    const CharSet first = program[0].op == Opcode::Char ? CharSet::single(program[0].c) : pattern.classes[program[0].x];
+    if (first == pattern.classes[program[1].x] && first == prefilter.first_chars.chars)
+    {
+      return FastPath::ClassRun;
+    }
+  }
+  return FastPath::None;
+}
+
+MatchResult fastPathSearch(const CompiledPattern& pattern, const char* text_start, const char* search_start, const char* text_end)
+{
+  const auto& prefilter = pattern.prefilter;
+  const int id = pattern.program.back().x;
+  switch (pattern.fast_path)
+  {
+  case FastPath::Literal:
+    if (auto found = findPrefilterLiteral(prefilter, search_start, text_end, prefilter.literal))
+    {
+      return MatchResult{ MatchStatus::Match, found, found + prefilter.literal.size(), id };
+    }
+    break;
+  case FastPath::AnchoredLiteral:
+    // A search confined to the literal's length is a prefix compare, case folding included.
+    if (search_start == text_start && static_cast<size_t>(text_end - text_start) >= prefilter.literal.size()
+      && findPrefilterLiteral(prefilter, text_start, text_start + prefilter.literal.size(), prefilter.literal) == text_start)
+    {
+      return MatchResult{ MatchStatus::Match, text_start, text_start + prefilter.literal.size(), id };
+    }
+    break;
+  case FastPath::ClassRun:
+    if (auto run_start = findInSet(search_start, text_end, prefilter.first_chars))
+    {
+      auto run_end = findNotInSet(run_start + 1, text_end, prefilter.first_chars);
+      return MatchResult{ MatchStatus::Match, run_start, run_end != nullptr ? run_end : text_end, id };
+    }
+    break;
+  case FastPath::None:
+    break;
+  }
+  return MatchResult{};
+}
+
+const char* fastPathName(FastPath fast_path)
+{
+  switch (fast_path)
+  {
+  case FastPath::Literal:
+    return "literal";
+  case FastPath::AnchoredLiteral:
+    return "anchored_literal";
+  case FastPath::ClassRun:
+    return "class_run";
+  case FastPath::None:
+    break;
+  }
+  return "none";
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "main.hpp"
+
+// The FastPath of a compiled program. Call it once the prefilter and end anchoring are in place: the
+// kernels read their literal or byte set from the prefilter.
+FastPath classifyFastPath(const CompiledPattern& pattern);
+
+// match_main for a pattern with a fast path: the leftmost-first match starting in [search_start, text_end),
+// the same one the engines would find.
+MatchResult fastPathSearch(const CompiledPattern& pattern, const char* text_start, const char* search_start, const char* text_end);
+
+// "literal", "anchored_literal", "class_run" or "none".
+const char* fastPathName(FastPath fast_path);
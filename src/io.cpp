@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io.hpp"
+#include "simd_scan.hpp"
+
+
+bool splitLongLine(LongLines& long_lines, const char* line_start, const char* line_end)
+{
+  if (long_lines == LongLines::SplitBinary && findByte(line_start, line_end, '\0') != nullptr)
+  {
+    long_lines = LongLines::Split;
+  }
+  return long_lines == LongLines::Split;
+}
+
+
+LineReader::LineReader(int fd, size_t block_size, LongLines long_lines)
+  : fd_(fd), buffer_(block_size), long_lines_(long_lines)
+{
+}
+
+bool LineReader::refill()
+{
+  // Keep the unfinished line, moving it to the front; grow only when a single line fills the block.
+  size_t pending = data_end_ - line_start_;
+  if (line_start_ > 0)
+  {
+    std::memmove(buffer_.data(), buffer_.data() + line_start_, pending);
+    scanned_to_ = scanned_to_ > line_start_ ? scanned_to_ - line_start_ : 0;
+    line_start_ = 0;
+    data_end_ = pending;
+  }
+  if (data_end_ == buffer_.size())
+  {
+    buffer_.resize(buffer_.size() * 2);
+  }
+
+  while (true)
+  {
+    ssize_t count = ::read(fd_, buffer_.data() + data_end_, buffer_.size() - data_end_);
+    if (count > 0)
+    {
+      data_end_ += static_cast<size_t>(count);
+      return true;
+    }
+    if (count == 0)
+    {
+      eof_ = true;
+      return false;
+    }
+    if (errno != EINTR)
+    {
+      throw std::runtime_error(std::string("read error: ") + std::strerror(errno));
+    }
+  }
+}
+
+bool LineReader::nextBlock(std::string_view& block)
+{
+  partial_ = false;
+  while (true)
+  {
+    // Only bytes read since the last look can hold a '\n', so a long line is not scanned again and again.
+    const char* data = buffer_.data();
+    auto last_newline = findLastByte(data + std::max(line_start_, scanned_to_), data + data_end_, '\n');
+    scanned_to_ = data_end_;
+    if (last_newline != nullptr)
+    {
+      block = std::string_view(data + line_start_, last_newline + 1 - (data + line_start_));
+      line_start_ = (last_newline - data) + 1;
+      return true;
+    }
+    if (line_start_ == 0 && data_end_ == buffer_.size() && splitLongLine(long_lines_, data, data + data_end_))
+    {
+      block = std::string_view(data, data_end_);
+      line_start_ = data_end_;
+      partial_ = true;
+      return true;
+    }
+
+    if (eof_ || !refill())
+    {
+      if (line_start_ == data_end_)
+      {
+        return false;
+      }
+      block = std::string_view(buffer_.data() + line_start_, data_end_ - line_start_);        // last line without '\n'
+      line_start_ = data_end_;
+      return true;
+    }
+  }
+}
+
+
+MappedFile::MappedFile(int fd)
+{
+  struct stat status{};
+  if (::fstat(fd, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size == 0)
+  {
+    return;
+  }
+
+  void* mapping = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED)
+  {
+    return;
+  }
+  ::madvise(mapping, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+  data_ = static_cast<const char*>(mapping);
+  size_ = static_cast<size_t>(status.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+  if (data_ != nullptr)
+  {
+    ::munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+
+OutputWriter::OutputWriter(int fd, size_t buffer_size)
+  : fd_(fd), buffer_(buffer_size)
+{
+}
+
+OutputWriter::~OutputWriter()
+{
+  try
+  {
+    flush();
+  }
+  catch (const std::exception&)
+  {
+  }
+}
+
+void OutputWriter::write(std::string_view text)
+{
+  if (text.size() > buffer_.size() - used_)
+  {
+    flush();
+    if (text.size() >= buffer_.size())
+    {
+      buffer_.resize(text.size());
+    }
+  }
+  std::memcpy(buffer_.data() + used_, text.data(), text.size());
+  used_ += text.size();
+}
+
+void OutputWriter::put(char c)
+{
+  if (used_ == buffer_.size())
+  {
+    flush();
+  }
+  buffer_[used_++] = c;
+}
+
+void OutputWriter::flush()
+{
+  size_t written = 0;
+  while (written < used_)
+  {
+    ssize_t count = ::write(fd_, buffer_.data() + written, used_ - written);
+    if (count < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      used_ = 0;
+      throw std::runtime_error(std::string("write error: ") + std::strerror(errno));
+    }
+    written += static_cast<size_t>(count);
+  }
+  used_ = 0;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// What a block reader does with a line too long for its buffer.
+enum class LongLines : std::uint8_t
+{
+  Grow,                           // grow the buffer until the line fits
+  Split,                          // hand the line out in buffer-sized pieces (see LineReader::partial)
+  SplitBinary                     // split lines holding a NUL byte, and every long line after the first of them
+};
+
+// Whether a line that fills a whole buffer, [line_start, line_end) so far, is to be handed out in pieces.
+// A SplitBinary policy turns into Split at the first such line that holds a NUL byte.
+bool splitLongLine(LongLines& long_lines, const char* line_start, const char* line_end);
+
+// Reads a file descriptor in large blocks and hands out runs of whole lines as views into the block,
+// each line keeping its '\n' (only the last line of the input may lack one). A view stays valid until
+// the next call to `nextBlock`. A line longer than the block grows the buffer, unless `long_lines` says
+// to split it: then it comes out as a run of partial blocks, and the block after the last of them starts
+// with the rest of the line.
+class LineReader
+{
+public:
+  explicit LineReader(int fd, size_t block_size = 256 * 1024, LongLines long_lines = LongLines::Grow);
+
+  bool nextBlock(std::string_view& block);
+  // The block last handed out is a piece of a line that the next block continues.
+  bool partial() const { return partial_; }
+
+private:
+  bool refill();
+
+  int fd_;
+  std::vector<char> buffer_;
+  size_t line_start_{};
+  size_t data_end_{};
+  size_t scanned_to_{};                   // the unfinished line has no '\n' before this offset
+  LongLines long_lines_;
+  bool partial_{ false };
+  bool eof_{ false };
+};
+
+// Read-only private mapping of a whole regular file. `valid()` is false when the file cannot be
+// mapped (pipes, terminals, empty files, ...) and must be read through LineReader instead.
+class MappedFile
+{
+public:
+  explicit MappedFile(int fd);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool valid() const { return data_ != nullptr; }
+  std::string_view contents() const { return { data_, size_ }; }
+
+private:
+  const char* data_{};
+  size_t size_{};
+};
+
+// Collects output in one large buffer and writes it with as few system calls as possible.
+class OutputWriter
+{
+public:
+  explicit OutputWriter(int fd, size_t buffer_size = 256 * 1024);
+  ~OutputWriter();
+
+  OutputWriter(const OutputWriter&) = delete;
+  OutputWriter& operator=(const OutputWriter&) = delete;
+
+  void write(std::string_view text);
+  void put(char c);
+  void flush();
+
+private:
+  int fd_;
+  std::vector<char> buffer_;
+  size_t used_{};
+};
@@ -0,0 +1,116 @@
+#include "line_search.hpp"
+#include "match_scratch.hpp"
+#include "prefilter.hpp"
+#include "simd_scan.hpp"
+
+
+// First position that could belong to a matching line, or nullptr when no line can match.
+static const char* nextLineCandidate(const Prefilter& prefilter, const char* text_it, const char* text_end)
+{
+  if (!prefilter.suffix.empty() && prefilter.suffix.find('\n') == std::string::npos)
+  {
+    // Only lines that end with the suffix can match, so skip occurrences that are not followed by '\n'.
+    for (const char* candidate = text_it; (candidate = findPrefilterLiteral(prefilter, candidate, text_end, prefilter.suffix)) != nullptr;
+      ++candidate)
+    {
+      const char* after = candidate + prefilter.suffix.size();
+      if (after == text_end || *after == '\n')
+      {
+        return candidate;
+      }
+    }
+    return nullptr;
+  }
+  if (!prefilter.literal.empty() && prefilter.literal.find('\n') == std::string::npos)
+  {
+    return findPrefilterLiteral(prefilter, text_it, text_end, prefilter.literal);
+  }
+  if (prefilter.has_first_chars)
+  {
+    return prefilter.first_char_list.empty() ? findInSet(text_it, text_end, prefilter.first_chars)
+      : findAnyByte(text_it, text_end, prefilter.first_char_list);
+  }
+  return text_it;
+}
+
+// For a fast-path pattern the candidate nextLineCandidate found settles its line without a match attempt:
+// it is an occurrence of the literal, or a byte a class run starts with (unless it is the line's '\n'),
+// and a `^literal` line matches when the first occurrence of the literal in it is at its start.
+static bool fastPathCandidateMatches(const CompiledPattern& pattern, const char* line_start, const char* candidate, const char* line_end)
+{
+  switch (pattern.fast_path)
+  {
+  case FastPath::Literal:
+    return true;
+  case FastPath::AnchoredLiteral:
+    return candidate == line_start;
+  case FastPath::ClassRun:
+    return candidate != line_end;
+  case FastPath::None:
+    break;
+  }
+  return false;
+}
+
+bool nextMatchingLine(const CompiledPattern& pattern, MatchScratch& scratch, const char*& text_it, const char* text_end, std::string_view& line,
+  int* pattern_id)
+{
+  std::chrono::steady_clock::time_point phase_start{};
+  if constexpr (statsEnabled)
+  {
+    phase_start = std::chrono::steady_clock::now();
+  }
+
+  while (text_it < text_end)
+  {
+    const char* candidate = nextLineCandidate(pattern.prefilter, text_it, text_end);
+    if constexpr (statsEnabled)
+    {
+      addElapsed(scratch.stats.prefilter_time, phase_start);
+    }
+    if (candidate == nullptr)
+    {
+      text_it = text_end;
+      return false;
+    }
+
+    const char* previous_newline = findLastByte(text_it, candidate, '\n');
+    const char* line_start = previous_newline ? previous_newline + 1 : text_it;
+    const char* line_end = findByte(candidate, text_end, '\n');
+    if (line_end == nullptr)
+    {
+      line_end = text_end;
+    }
+    text_it = line_end == text_end ? text_end : line_end + 1;
+
+    MatchResult match{};
+    if (pattern.fast_path != FastPath::None)
+    {
+      match.status = fastPathCandidateMatches(pattern, line_start, candidate, line_end) ? MatchStatus::Match : MatchStatus::NoMatch;
+      match.pattern = pattern.program.back().x;
+    }
+    else
+    {
+      match = match_main(pattern, line_start, line_end, scratch);
+    }
+    if constexpr (statsEnabled)
+    {
+      ++scratch.stats.candidate_lines;
+      addElapsed(scratch.stats.engine_time, phase_start);
+    }
+    if (match.status == MatchStatus::Match)
+    {
+      line = std::string_view(line_start, line_end - line_start);
+      if (pattern_id != nullptr)
+      {
+        *pattern_id = match.pattern;
+      }
+      return true;
+    }
+    if (match.status == MatchStatus::BudgetExceeded)
+    {
+      ++scratch.budget_exceeded;                    // reported by the caller; the line counts as not matching
+    }
+  }
+  return false;
+}
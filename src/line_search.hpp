@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string_view>
+
+#include "main.hpp"
+
+// Searches a buffer of '\n'-terminated lines as a whole. The prefilter runs over the entire buffer and
+// a candidate is widened to its enclosing line only when found, so lines that cannot match are never
+// visited one by one. Stores the next matching line (without its '\n') in `line`, advances `text_it`
+// past it and returns true; returns false once the buffer is exhausted. When given, `pattern_id` receives
+// the id of the pattern that matched (see compilePatterns).
+bool nextMatchingLine(const CompiledPattern& pattern, MatchScratch& scratch, const char*& text_it, const char* text_end, std::string_view& line,
+  int* pattern_id = nullptr);
@@ -1,642 +1,539 @@
-#include <iostream>
 #include <string>
 #include <string_view>
 #include <algorithm>
-#include <functional>
 #include <stdexcept>
-#include <cctype>
-#include <stack>
-#include <memory>
 #include <vector>
 
+#include "compiler.hpp"
+#include "fast_path.hpp"
 #include "main.hpp"
+#include "match_scratch.hpp"
+#include "pike_vm.hpp"
+#include "prefilter.hpp"
 
 
-static std::vector<std::string> backReference{};
-
-
-constexpr bool isAnyMetaCharacter(const char c)
-{
-  return (
-    (c == '^') ||
-    (c == '$') ||
-
-    (c == '[') ||
-    (c == ']') ||
-    (c == '(') ||
-    (c == ')') ||
-
-    (c == '{') ||
-    (c == '}') ||
-
-    (c == '+') ||
-    (c == '*') ||
-    (c == '?') ||
-
-    (c == '.') ||
-
-    (c == '\\') ||
-
-    (c == '|')
-    );
-}
-
-constexpr bool isQuantifier(const char c)
-{
-  return (
-    (c == '+') ||
-    (c == '*') ||
-    (c == '?')
-    );
-}
-
-constexpr bool isQuantifierAdvanced(const char c)
-{
-  return (
-    (c == '+') ||
-    (c == '*') ||
-    (c == '?') ||
-    (c == '{')
-    );
-}
-
-constexpr bool isCharacterClass(const char c)
-{
-  return (
-    (c == 'w') ||
-    (c == 'W') ||
-    (c == 's') ||
-    (c == 'S') ||
-    (c == 'd') ||
-    (c == 'D') ||
-    (c == 'w') ||
-    (c == 'W') ||
-    (c == 'x') ||
-    (c == 'O') ||
-    (c == 'c')
-    );
-}
-
-constexpr bool isGroup(const char c)
-{
-  return (
-    (c == '[') ||
-    (c == ']') ||
-    (c == '(') ||
-    (c == ')')
-    );
-}
-
-
-constexpr bool is_w(const char c)
-{
-  return (
-    (c >= 'a' && c <= 'z') ||
-    (c >= 'Z' && c <= 'Z') ||
-    (c >= '0' && c <= '9') ||
-    (c == '_')
-    );
-}
-constexpr bool is_W(const char c)
-{
-  return !is_w(c);
-}
-
-bool is_d(const char c)
-{
-  return isdigit(c);
-}
-bool is_D(const char c)
-{
-  return !is_d(c);
-}
-
-
-std::function<bool(const char)> characterClassSelector(const char c)
+bool backReference_match_main(const char* text_start, const char* text_end,
+  const char* back_ref_start, const char* back_ref_end, bool ignore_case)
 {
-  switch (c)
+  if (ignore_case)
   {
-  case 'w':
-    return is_w;
-    break;
-  case 'W':
-    return is_W;
-    break;
-  case 'd':
-    return is_d;
-    break;
-  case 'D':
-    return is_D;
-    break;
-
-  default:
-    throw std::invalid_argument("Character Class must receive valid character");
-    break;
-  }
-}
-
-
-std::function<bool(const char)> plainCharacterMatcherBuilder(const std::shared_ptr<std::vector<char>>& sharedPlainChars)
-{
-  return [sharedPlainChars](const char c) -> bool
+    for (; back_ref_start != back_ref_end && text_start != text_end; ++back_ref_start, ++text_start)
     {
-      for (const auto plainChar : *sharedPlainChars)
-      {
-        if (plainChar == c)
-        {
-          return true;
-        }
+      if (toLowerAscii(*back_ref_start) != toLowerAscii(*text_start)) {
+        return false;
       }
-      return false;
-    };
-}
-
+    }
+    return back_ref_start == back_ref_end;
+  }
 
-bool matcherControl(const std::vector<std::function<bool(const char)>>& matchers, const char c)
-{
-  for (const auto& matcher : matchers)
+  for (; back_ref_start != back_ref_end && text_start != text_end; ++back_ref_start, ++text_start)
   {
-    if (matcher(c))
-    {
-      return true;
+    if (*back_ref_start != *text_start) {
+      return false;
     }
   }
-  return false;
+
+  return back_ref_start == back_ref_end;
 }
 
-std::vector<std::function<bool(const char)>> matcherControlSetupBuilder(std::string::const_iterator pattern_start, std::string::const_iterator pattern_end)
+// A failed backtracker state (pc, offset) fails again on every later visit as long as nothing after pc
+// reads capture slots, so only pcs that cannot reach a Backref or Progress get a memo row.
+static void buildMemoRows(CompiledPattern& compiled)
 {
-  std::vector<std::function<bool(const char)>> matchers{};
-  auto sharedPlainChars = std::make_shared<std::vector<char>>();
-
-  while (pattern_start != pattern_end)
+  const int size = static_cast<int>(compiled.program.size());
+  std::vector<char> reads_slots(size, 0);
+  for (bool changed = true; changed; )
   {
-    if (*pattern_start == '.')                      // Early exit if sub_pattern contains `.`
+    changed = false;
+    for (int pc = size - 1; pc >= 0; --pc)
     {
-      return { [](const char) -> bool { return true; } };
-    }
-    else if (*pattern_start == '\\')                // handle scape character
-    {
-      if (pattern_start + 1 == pattern_end)
-      {
-        throw std::invalid_argument("Error: Dangling backslash.");
-      }
-      else if (isCharacterClass(*(pattern_start + 1)))
+      const auto& instruction = compiled.program[pc];
+      bool reads = false;
+      switch (instruction.op)
       {
-        matchers.push_back(characterClassSelector(*(pattern_start + 1)));
+      case Opcode::Backref:
+      case Opcode::Progress:
+        reads = true;
+        break;
+      case Opcode::Split:
+        reads = reads_slots[instruction.x] || reads_slots[instruction.y];
+        break;
+      case Opcode::Jump:
+        reads = reads_slots[instruction.x];
+        break;
+      case Opcode::Fail:
+      case Opcode::Match:
+        break;
+      default:
+        reads = reads_slots[pc + 1];
+        break;
       }
-      else
+      if (reads && !reads_slots[pc])
       {
-        sharedPlainChars->push_back(*(pattern_start + 1));
+        reads_slots[pc] = 1;
+        changed = true;
       }
-      pattern_start += 2;
     }
-    else                                            // plain character
+  }
+
+  compiled.memo_row.assign(size, -1);
+  compiled.memo_rows = 0;
+  for (int pc = 0; pc < size; ++pc)
+  {
+    if (!reads_slots[pc])
     {
-      sharedPlainChars->push_back(*pattern_start);
-      ++pattern_start;
+      compiled.memo_row[pc] = compiled.memo_rows++;
     }
   }
-
-  matchers.push_back(plainCharacterMatcherBuilder(sharedPlainChars));
-  return matchers;
 }
 
-bool matcherControlSetup(std::string::const_iterator pattern_start, std::string::const_iterator pattern_end, const char c, bool negative_group_flag)
+// The run-time extras on top of the shared compiler: prefilter and backtracker memo rows.
+static void finishProgram(CompiledPattern& compiled, int group_count)
 {
-  if (!negative_group_flag)
-    return matcherControl(matcherControlSetupBuilder(pattern_start, pattern_end), c);
-  else
-    return !matcherControl(matcherControlSetupBuilder(pattern_start, pattern_end), c);
+  resolveLoopGuards(compiled, group_count);
+  compiled.prefilter = buildPrefilter(compiled);
+  buildMemoRows(compiled);                          // also used by extractCaptures on Pike VM patterns
 }
 
-bool matcherControlSetupMemoized(std::vector<std::function<bool(const char)>>& matchers, const char c, bool negative_group_flag)
-{
-  if (!negative_group_flag)
-    return matcherControl(matchers, c);
-  else
-    return !matcherControl(matchers, c);
-}
-
-
-RecResult patternControl(std::string::const_iterator text_start, std::string::const_iterator text_end,
-  std::string::const_iterator pattern_start, std::string::const_iterator pattern_end)
+// Compiles `pattern` a second time right to left. When every match of the result starts with `$` (so every
+// forward match ends at the end of the text), the pattern becomes end-anchored: it is matched backwards from
+// the end and texts that lack its literal suffix are rejected up front.
+static void attachReversed(CompiledPattern& compiled, const std::string& pattern)
 {
-  if (pattern_start == pattern_end)
-  {
-    return RecResult{text_start, true};                            // pattern matched
-  }
-  if (*pattern_start == '$' && pattern_start + 1 == pattern_end)
-  {
-    return text_start == text_end ? RecResult({ text_start, true }) : RecResult{};          // pattern must end here
-  }
-  if (text_start == text_end)
-  {
-    return RecResult{};                           // text ended without match
-  }
-  if (isQuantifierAdvanced(*pattern_start))
-  {
-    return RecResult{};                           // throw std::invalid_argument("Error: Invalid target for quantifier.");
-  }
-  if (*pattern_start == '^' || *pattern_start == '$')
-  {
-    return RecResult{};                           // misused meta characters making regex impossible to have a valid match
-  }
-
-  if (isGroup(*pattern_start))
-  {
-    return handleGroups(text_start, text_end, pattern_start, pattern_end);
-  }
-  if (*pattern_start == '\\')
-  {
-    return handleScapedCharacter(text_start, text_end, pattern_start, pattern_end);
-  }
-  if (pattern_start + 1 != pattern_end && isQuantifierAdvanced(*(pattern_start + 1)))
+  if (compiled.has_backreferences)
   {
-    return quantifierLoop(text_start, text_end, pattern_start, pattern_end, pattern_start + 1);
+    return;
   }
-  // vvv will run and not break/exit process sequence vvv
-  if (matcherControlSetup(pattern_start, pattern_start + 1, *text_start))
+  CompiledPattern reversed(compiled.program.get_allocator().resource());
+  reversed.ignore_case = compiled.ignore_case;
+  int next_group = 0;
+  compileAlternation(reversed, pattern.begin(), pattern.end(), next_group, true);
+  emit(reversed, Opcode::Match, '\0', compiled.program.back().x);
+  resolveLoopGuards(reversed, next_group);
+  if (reversed.has_backreferences)
   {
-    return patternControl(text_start + 1, text_end, pattern_start + 1, pattern_end);
+    return;                                         // `\N` before its group reads differently right to left
   }
-  // ^^^ must be the last condition ^^^
-  return RecResult{};
-}
-
 
-std::string::const_iterator parseQuantifierRange(int& min, int& max, std::string::const_iterator start, std::string::const_iterator end)
-{
-  const auto new_end = std::find(start, end, '}');
-  if (new_end == end)
+  std::vector<char> jump_target(reversed.program.size() + 1);
+  for (const auto& instruction : reversed.program)
   {
-    throw std::runtime_error("Closing '}' not found");
+    if (instruction.op == Opcode::Split || instruction.op == Opcode::Jump)
+    {
+      jump_target[instruction.x] = 1;
+    }
+    if (instruction.op == Opcode::Split)
+    {
+      jump_target[instruction.y] = 1;
+    }
   }
-
-  auto comma = std::find(start, new_end, ',');
-
-  // Parse the first number (min)
-  std::string first_num(start, comma);
-  first_num.erase(std::remove_if(first_num.begin(), first_num.end(), ::isspace), first_num.end());
-
-  if (first_num.empty() || !std::all_of(first_num.begin(), first_num.end(), ::isdigit))
+  // The straight-line head of the reversed program runs on every path: Saves, then `$`, then the suffix.
+  size_t pc = 0;
+  while (reversed.program[pc].op == Opcode::Save && !jump_target[pc + 1])
   {
-    throw std::runtime_error("Invalid number format for min");
+    ++pc;
   }
-
-  min = std::stoi(first_num);
-
-  if (comma == new_end)
+  if (reversed.program[pc].op != Opcode::AssertEnd)
   {
-    // No comma found, max = min
-    max = min;
+    return;
   }
-  else
+  PatternString suffix(compiled.program.get_allocator());
+  for (++pc; !jump_target[pc]; ++pc)
   {
-    // Comma found, parse the second number (max)
-    std::string second_num(comma + 1, new_end);
-    second_num.erase(std::remove_if(second_num.begin(), second_num.end(), ::isspace), second_num.end());
-
-    if (second_num.empty())
-    {
-      // Empty value between ',' and '}'
-      max = -1;
-    }
-    else if (!std::all_of(second_num.begin(), second_num.end(), ::isdigit))
+    char c{};
+    if (literalByte(reversed, reversed.program[pc], c))
     {
-      throw std::runtime_error("Invalid number format for max");
+      suffix.insert(suffix.begin(), c);
     }
-    else
+    else if (reversed.program[pc].op != Opcode::Save)
     {
-      max = std::stoi(second_num);
+      break;
     }
   }
 
-  // Ensure min is non-negative
-  if (min < 0)
-  {
-    throw std::runtime_error("Min cannot be negative");
-  }
+  compiled.anchored_end = true;
+  compiled.prefilter.suffix = std::move(suffix);
+  compiled.reversed.push_back(std::move(reversed));
+}
 
-  // Ensure max is non-negative, except when it's -1
-  if (max < -1)
-  {
-    throw std::runtime_error("Max cannot be negative (except -1)");
-  }
+CompiledPattern compilePattern(const std::string& pattern, bool ignore_case, std::pmr::memory_resource* memory)
+{
+  CompiledPattern compiled(memory);
+  compiled.ignore_case = ignore_case;
+  int next_group = 0;
 
-  // Ensure min <= max, except when max is -1
-  if (max != -1 && min > max)
-  {
-    throw std::runtime_error("Min cannot be greater than max");
-  }
+  compileAlternation(compiled, pattern.begin(), pattern.end(), next_group);
+  emit(compiled, Opcode::Match);
+  finishProgram(compiled, next_group);
+  attachReversed(compiled, pattern);
+  compiled.fast_path = classifyFastPath(compiled);
 
-  return new_end + 1;
+  return compiled;
 }
 
-std::string::const_iterator handleQuantifier(std::string::const_iterator quantifier_start, std::string::const_iterator pattern_end, int& min, int& max)
+CompiledPattern compilePatterns(const std::vector<std::string>& patterns, const std::vector<int>& ids, bool ignore_case,
+  std::pmr::memory_resource* memory)
 {
-  if (*quantifier_start == '*')
-  {
-    min = 0;
-    max = -1;                       // -1 == infinite
-  }
-  else if (*quantifier_start == '+')
-  {
-    min = 1;
-    max = -1;                       // -1 == infinite
-  }
-  else if (*quantifier_start == '?')
-  {
-    min = 0;
-    max = 1;
-  }
-  else if (*quantifier_start == '{')
+  if (patterns.empty() || patterns.size() != ids.size())
   {
-    return parseQuantifierRange(min, max, quantifier_start + 1, pattern_end) + 1;       // handle custom quantifier {n, m} | {n} | {n,}
-  }
-  return quantifier_start + 1;
-}
-
-RecResult quantifierLoop(std::string::const_iterator text_start, std::string::const_iterator text_end,
-  std::string::const_iterator pattern_start, std::string::const_iterator pattern_end,
-  std::string::const_iterator quantifier_start,                   // pattern_start < quantifier_start < pattern_end
-  bool negative_group_flag, int pattern_end_offset)
-{
-  auto matchers = matcherControlSetupBuilder(pattern_start, quantifier_start - pattern_end_offset);
-  int min{};
-  int max{};
-  auto new_pattern_start = handleQuantifier(quantifier_start, pattern_end, min, max);
-
-  // Find the maximum number of matches possible
-  auto text_it = text_start;
-  int max_matches = 0;
-  while (text_it != text_end && (max == -1 || max_matches < max) &&
-    matcherControlSetupMemoized(matchers, *text_it, negative_group_flag)) {
-    ++max_matches;
-    ++text_it;
+    throw std::runtime_error("compilePatterns needs one id per pattern");
   }
 
-  // Try matches from max_matches down to min
-  for (int matches = max_matches; matches >= min; --matches) {
-    auto current_text_start = text_start + matches;
-    auto rec_result = patternControl(current_text_start, text_end, new_pattern_start, pattern_end);
-    if (rec_result.is_valid) {
-      return rec_result;
+  // Split chain: every branch runs one pattern to its own Match. Each pattern numbers its groups from
+  // zero, so its back references see its own captures; the branches never run together.
+  CompiledPattern compiled(memory);
+  compiled.ignore_case = ignore_case;
+  int group_count = 0;
+  for (size_t i = 0; i < patterns.size(); ++i)
+  {
+    int split = -1;
+    if (i + 1 < patterns.size())
+    {
+      split = emit(compiled, Opcode::Split);
+      compiled.program[split].x = split + 1;
+    }
+    int next_group = 0;
+    compileAlternation(compiled, patterns[i].begin(), patterns[i].end(), next_group);
+    emit(compiled, Opcode::Match, '\0', ids[i]);
+    group_count = std::max(group_count, next_group);
+    if (split >= 0)
+    {
+      compiled.program[split].y = static_cast<int>(compiled.program.size());
     }
   }
+  finishProgram(compiled, group_count);
+  compiled.fast_path = classifyFastPath(compiled);
 
-  return RecResult{};
+  return compiled;
 }
 
 
-RecResult handleGroups(std::string::const_iterator text_start, std::string::const_iterator text_end,
-  std::string::const_iterator pattern_start, std::string::const_iterator pattern_end)
+// Runs the program from pc 0 at `text_it` without recursing: every choice point (an untried Split
+// branch, a Star that can give back characters, a capture slot to restore) is pushed on the explicit
+// backtrack stack in MatchScratch. `steps` is shared by all start offsets of one search and the run
+// stops with BudgetExceeded once it passes the scratch's step budget. With `memo_stride` set, states
+// that have a memo row are recorded in the scratch's visited bitmap and a repeated one fails at once,
+// which bounds the work on those states by program size x text length.
+static MatchStatus backtrack(const CompiledPattern& pattern, MatchScratch& scratch,
+  const char* text_start, const char* text_end, const char* text_it, MatchResult& match, std::uint64_t& steps,
+  size_t memo_stride)
 {
-  if (*pattern_start == '[')
-  {
-    bool isNegativeGroup = false;
-    auto group_end = std::find(pattern_start, pattern_end, ']');
-
-    if (group_end == pattern_end)
+  const char* const match_start = text_it;
+  auto& captureSlots = scratch.capture_slots;
+  auto& visited = scratch.visited;
+  auto& stack = scratch.backtrack_stack;
+  const std::uint64_t budget = scratch.step_budget;
+  const bool fixed_capacity = scratch.fixed_capacity;
+  stack.clear();
+  int pc = 0;
+
+  while (true)
+  {
+    if (budget != 0 && ++steps > budget)
     {
-      throw std::runtime_error("Closing ']' not found");
+      return MatchStatus::BudgetExceeded;
     }
-
-    if (*(pattern_start + 1) == '^')
+    if (fixed_capacity && stack.size() == stack.capacity())
     {
-      isNegativeGroup = true;
-      ++pattern_start;
+      return MatchStatus::BudgetExceeded;           // a step pushes at most one frame, and this one might not fit
     }
 
-    if (group_end + 1 != pattern_end && isQuantifierAdvanced(*(group_end + 1)))
+    if constexpr (statsEnabled)
     {
-      return quantifierLoop(text_start, text_end, pattern_start, pattern_end, group_end + 1, isNegativeGroup, 1);
+      ++scratch.stats.backtrack_steps;
+      scratch.stats.max_backtrack_depth = std::max<std::uint64_t>(scratch.stats.max_backtrack_depth, stack.size());
     }
-    if (matcherControlSetup(pattern_start + 1, group_end, *text_start, isNegativeGroup))
-    {
-      return patternControl(text_start + 1, text_end, group_end + 1, pattern_end);
-    }
-  }
-  if (*pattern_start == '(')
-  {
-    auto group_end = findClosingParenthesis(pattern_start, pattern_end);
 
-    if (group_end == pattern_end)
+    const auto& instruction = pattern.program[pc];
+    bool seen = false;
+    if (memo_stride != 0 && pattern.memo_row[pc] >= 0)
     {
-      throw std::runtime_error("Closing ')' not found");
+      size_t bit = pattern.memo_row[pc] * memo_stride + static_cast<size_t>(text_it - text_start);
+      std::uint64_t mask = std::uint64_t{ 1 } << (bit % 64);
+      seen = (visited[bit / 64] & mask) != 0;
+      visited[bit / 64] |= mask;
     }
 
-    int backReferenceIndex = backReference.size(); // size before recusion
-    backReference.emplace_back();
-    auto group_rec_result = group_match_main(text_start, text_end, pattern_start + 1, group_end);
-    if (group_rec_result.is_valid)
+    bool failed = false;
+    switch (seen ? Opcode::Fail : instruction.op)
     {
-      auto groupCapturedSize = group_rec_result.result - text_start;
-      backReference[backReferenceIndex] = std::string(text_start, text_start + groupCapturedSize);
-      auto rec_result = patternControl(text_start + groupCapturedSize, text_end, group_end + 1, pattern_end);
-      if (rec_result.is_valid)
+    case Opcode::Char:
+      if (text_it == text_end || *text_it != instruction.c)
       {
-        return rec_result;
+        failed = true;
+        break;
       }
-    }
-    backReference.pop_back();
-  }
-
-  return RecResult{};
-}
-
-
-RecResult handleScapedCharacter(std::string::const_iterator text_start, std::string::const_iterator text_end,
-  std::string::const_iterator pattern_start, std::string::const_iterator pattern_end)
-{
-  if (pattern_start + 1 == pattern_end)
-  {
-    return RecResult{};                       // throw std::invalid_argument("Error: Dangling backslash.");
-  }
-
-  int possibleBackRefIndex = (*(pattern_start + 1) - '0');
-  
-  if (pattern_start + 2 != pattern_end && isQuantifierAdvanced(*(pattern_start + 2)))         // "\xq" where x is a character and q is a quantifier
-  {
-    return quantifierLoop(text_start, text_end, pattern_start, pattern_end, pattern_start + 2);
-  }
-  else if ((possibleBackRefIndex) >= 1 && (size_t)(possibleBackRefIndex) <= backReference.size())    // TODO support > 9 and quantifier
-  {
-    if (backReference_match_main(text_start, text_end, backReference[possibleBackRefIndex - 1].begin(), backReference[possibleBackRefIndex - 1].end()))
+      ++text_it;
+      ++pc;
+      break;
+    case Opcode::Class:
+      if (text_it == text_end || !pattern.classes[instruction.x].contains(*text_it))
+      {
+        failed = true;
+        break;
+      }
+      ++text_it;
+      ++pc;
+      break;
+    case Opcode::Any:
+      if (text_it == text_end)
+      {
+        failed = true;
+        break;
+      }
+      ++text_it;
+      ++pc;
+      break;
+    case Opcode::Star:
     {
-      return patternControl(text_start + backReference[possibleBackRefIndex - 1].size(), text_end, pattern_start + 2, pattern_end);
+      // Scan the whole run in one tight loop, then give back one character at a time on failure.
+      const auto& chars = pattern.classes[instruction.x];
+      auto run_end = text_it;
+      while (run_end != text_end && chars.contains(*run_end))
+      {
+        ++run_end;
+      }
+      steps += static_cast<std::uint64_t>(run_end - text_it);
+      if (run_end != text_it)
+      {
+        stack.push_back(BacktrackFrame{ BacktrackFrame::Kind::GiveBack, pc + 1, run_end - 1, text_it });
+      }
+      text_it = run_end;
+      ++pc;
+      break;
     }
-  }
-  else if (matcherControlSetup(pattern_start, pattern_start + 2, *text_start))                // "\xz" where x is a character and z is not a quantifier, or
-  {                                                                                           // "\x"  where x is a character and the pattern ends after x
-    return patternControl(text_start + 1, text_end, pattern_start + 2, pattern_end);
-  }
-  return RecResult{};
-}
-
-
-bool backReference_match_main(std::string::const_iterator text_start, std::string::const_iterator text_end,
-  std::string::const_iterator back_ref_start, std::string::const_iterator back_ref_end)
-{
-  for (; back_ref_start != back_ref_end && text_start != text_end; ++back_ref_start, ++text_start)
-  {
-    if (*back_ref_start != *text_start) {
-      return false;
+    case Opcode::Repeat:
+    {
+      // Like Star, but the run stops after z characters and gives back no further than y.
+      const auto& chars = pattern.classes[instruction.x];
+      const auto run_limit = text_it + std::min<std::ptrdiff_t>(instruction.z, text_end - text_it);
+      auto run_end = text_it;
+      while (run_end != run_limit && chars.contains(*run_end))
+      {
+        ++run_end;
+      }
+      steps += static_cast<std::uint64_t>(run_end - text_it);
+      if (run_end - text_it < instruction.y)
+      {
+        failed = true;
+        break;
+      }
+      if (run_end - text_it > instruction.y)
+      {
+        stack.push_back(BacktrackFrame{ BacktrackFrame::Kind::GiveBack, pc + 1, run_end - 1, text_it + instruction.y });
+      }
+      text_it = run_end;
+      ++pc;
+      break;
     }
-  }
-
-  return back_ref_start == back_ref_end;
-}
-
-
-std::string::const_iterator findOutermostOr(std::string::const_iterator pattern_start, std::string::const_iterator pattern_end)
-{
-  std::stack<char> brackets;
-
-  for (; pattern_start != pattern_end; ++pattern_start) {
-    switch (*pattern_start) {
-    case '(':
-    case '[':
-      brackets.push(*pattern_start);
+    case Opcode::Split:
+      stack.push_back(BacktrackFrame{ BacktrackFrame::Kind::Branch, instruction.y, text_it, nullptr });
+      pc = instruction.x;
       break;
-    case ')':
-      if (!brackets.empty() && brackets.top() == '(') {
-        brackets.pop();
-      }
+    case Opcode::Jump:
+      pc = instruction.x;
       break;
-    case ']':
-      if (!brackets.empty() && brackets.top() == '[') {
-        brackets.pop();
+    case Opcode::Save:
+      stack.push_back(BacktrackFrame{ BacktrackFrame::Kind::Restore, instruction.x, captureSlots[instruction.x], nullptr });
+      captureSlots[instruction.x] = text_it;
+      if constexpr (statsEnabled)
+      {
+        ++scratch.stats.capture_saves;
       }
+      ++pc;
+      break;
+    case Opcode::Progress:
+      failed = captureSlots[instruction.x] == text_it;
+      ++pc;
       break;
-    case '|':
-      if (brackets.empty()) {
-        return pattern_start;  // Found outermost '|'
+    case Opcode::Backref:
+    {
+      auto back_ref_start = captureSlots[2 * instruction.x];
+      auto back_ref_end = captureSlots[2 * instruction.x + 1];
+      if (back_ref_start == nullptr || back_ref_end == nullptr ||
+        !backReference_match_main(text_it, text_end, back_ref_start, back_ref_end, pattern.ignore_case))
+      {
+        failed = true;
+        break;
       }
+      text_it += back_ref_end - back_ref_start;
+      ++pc;
       break;
     }
-  }
-
-  return pattern_end;  // No outermost '|' found
-}
-
-std::string::const_iterator findClosingParenthesis(std::string::const_iterator start, std::string::const_iterator end)
-{
-  int scope = 0;
-  bool foundOpeningParenthesis = false;
-
-  for (auto it = start; it != end; ++it)
-  {
-    if (*it == '(')
-    {
-      scope++;
-      foundOpeningParenthesis = true;
+    case Opcode::AssertBegin:
+      failed = text_it != text_start;
+      ++pc;
+      break;
+    case Opcode::AssertEnd:
+      failed = text_it != text_end;
+      ++pc;
+      break;
+    case Opcode::Fail:
+      failed = true;
+      break;
+    case Opcode::Match:
+      match = MatchResult{ MatchStatus::Match, match_start, text_it, instruction.x };
+      return MatchStatus::Match;
     }
-    else if (*it == ')')
+
+    // Resume at the most recent choice point, undoing capture writes made after it.
+    while (failed)
     {
-      if (!foundOpeningParenthesis)
+      if (stack.empty())
       {
-        throw std::runtime_error("Closing parenthesis found before opening parenthesis");
+        return MatchStatus::NoMatch;
       }
-      scope--;
-      if (scope == 0)
+      auto frame = stack.back();
+      stack.pop_back();
+      switch (frame.kind)
       {
-        return it;  // Found the closing parenthesis in the same scope
+      case BacktrackFrame::Kind::Restore:
+        captureSlots[frame.pc] = frame.text_it;
+        break;
+      case BacktrackFrame::Kind::GiveBack:
+        if (frame.text_it != frame.run_start)
+        {
+          stack.push_back(BacktrackFrame{ BacktrackFrame::Kind::GiveBack, frame.pc, frame.text_it - 1, frame.run_start });
+        }
+        [[fallthrough]];
+      case BacktrackFrame::Kind::Branch:
+        pc = frame.pc;
+        text_it = frame.text_it;
+        failed = false;
+        break;
       }
     }
   }
+}
 
-  if (!foundOpeningParenthesis)
+void prepareMatchScratch(MatchScratch& scratch, const CompiledPattern& pattern)
+{
+  if (scratch.capture_slots.size() < static_cast<size_t>(pattern.slot_count))
   {
-    throw std::runtime_error("No opening parenthesis found");
+    scratch.capture_slots.resize(pattern.slot_count);
   }
-  else
+  scratch.current_threads.reserve(pattern.program.size(), pattern.counted_threads);
+  scratch.next_threads.reserve(pattern.program.size(), pattern.counted_threads);
+  scratch.pending_pcs.reserve(2 * pattern.program.size() + 1);      // each visited pc pushes at most two successors
+  scratch.backtrack_stack.reserve(std::max<size_t>(256, 4 * pattern.program.size()));
+  scratch.visited.reserve((bitStateMaxBits + pattern.memo_rows) / 64 + 1);      // what resetMemo can ask for
+  for (const auto& reversed : pattern.reversed)
   {
-    throw std::runtime_error("Unmatched opening parenthesis: scope never closed");
+    prepareMatchScratch(scratch, reversed);
   }
 }
 
-
-RecResult group_match_main(std::string::const_iterator text_start, std::string::const_iterator text_end,
-  std::string::const_iterator pattern_start, std::string::const_iterator pattern_end)
+// Memoized states stay valid across start offsets, so one bitmap serves a whole search. It is only used
+// while it fits in bitStateMaxBits, i.e. for short texts such as single lines. Returns the memo stride.
+static size_t resetMemo(const CompiledPattern& pattern, MatchScratch& scratch, const char* text_start, const char* text_end)
 {
-  if (pattern_start == pattern_end)
+  const size_t text_length = static_cast<size_t>(text_end - text_start);
+  if (pattern.memo_rows == 0 || text_length >= bitStateMaxBits / pattern.memo_rows)
   {
-    return RecResult{};
+    return 0;
   }
+  scratch.visited.assign((pattern.memo_rows * (text_length + 1) + 63) / 64, 0);
+  return text_length + 1;
+}
 
-  auto orPosition = findOutermostOr(pattern_start, pattern_end);
+MatchResult match_main(const CompiledPattern& pattern, const char* text_start, const char* text_end, MatchScratch& scratch)
+{
+  return match_main(pattern, text_start, text_start, text_end, scratch);
+}
 
-  while (orPosition != pattern_end)
+MatchResult match_main(const CompiledPattern& pattern, const char* text_start, const char* search_start, const char* text_end,
+  MatchScratch& scratch)
+{
+  if (pattern.fast_path != FastPath::None)
+  {
+    return fastPathSearch(pattern, text_start, search_start, text_end);
+  }
+  if (!prefilterAccepts(pattern.prefilter, search_start, text_end) || (pattern.anchored_begin && search_start != text_start))
   {
-    auto group_rec_result = group_match_main(text_start, text_end, pattern_start, orPosition);
-    if (group_rec_result.is_valid) {
-      return group_rec_result;
+    if constexpr (statsEnabled)
+    {
+      ++scratch.stats.prefilter_rejects;
     }
-    pattern_start = orPosition + 1;
-    orPosition = findOutermostOr(pattern_start, pattern_end);
+    return MatchResult{};
   }
-  
-  return patternControl(text_start, text_end, pattern_start, pattern_end);
-}
 
-RecResult match_main(std::string::const_iterator text_start, std::string::const_iterator text_end,
-  std::string::const_iterator pattern_start, std::string::const_iterator pattern_end)
-{
-  if (pattern_start == pattern_end)
+  prepareMatchScratch(scratch, pattern);
+  if (pattern.anchored_end)
   {
-    return RecResult{};
+    // Every match ends at text_end, so the leftmost-first match is the one with the leftmost start.
+    const char* match_start = nullptr;
+    auto status = reversePikeVmSearch(pattern.reversed.front(), text_start, search_start, text_end, scratch, match_start);
+    if (status != MatchStatus::BudgetExceeded)
+    {
+      return match_start ? MatchResult{ MatchStatus::Match, match_start, text_end, pattern.program.back().x } : MatchResult{};
+    }
   }
-
-  auto orPosition = findOutermostOr(pattern_start, pattern_end);
-
-  while (orPosition != pattern_end)
+  if (!pattern.has_backreferences)
   {
-    auto main_rec_result = match_main(text_start, text_end, pattern_start, orPosition);
-    if (main_rec_result.is_valid) {
-      return main_rec_result;
+    auto match = pikeVmSearch(pattern, text_start, search_start, text_end, scratch);
+    if (match.status != MatchStatus::BudgetExceeded)
+    {
+      return match;
+    }
+    if constexpr (statsEnabled)
+    {
+      ++scratch.stats.counted_fallbacks;
     }
-    pattern_start = orPosition + 1;
-    orPosition = findOutermostOr(pattern_start, pattern_end);
+    // A counted repetition outgrew the thread lists: the backtracker keeps each count in one frame.
   }
 
-  if (*pattern_start == '^') {
-    return patternControl(text_start, text_end, pattern_start + 1, pattern_end);
-  }
+  std::fill(scratch.capture_slots.begin(), scratch.capture_slots.begin() + pattern.slot_count, nullptr);
+  std::uint64_t steps = 0;
+  const size_t memo_stride = resetMemo(pattern, scratch, text_start, text_end);
 
-  do
+  const char* text_it = pattern.anchored_begin ? text_start : nextCandidate(pattern.prefilter, search_start, text_end);
+  while (text_it != nullptr)
   {
-    auto rec_result = patternControl(text_start, text_end, pattern_start, pattern_end);
-    if (rec_result.is_valid)
+    MatchResult match{};
+    if constexpr (statsEnabled)
     {
-      return rec_result;
+      ++scratch.stats.start_offsets;
     }
-  } while (++text_start != text_end);
-  return RecResult{};
+    auto status = backtrack(pattern, scratch, text_start, text_end, text_it, match, steps, memo_stride);
+    if (status != MatchStatus::NoMatch)
+    {
+      match.status = status;
+      return match;
+    }
+    if (pattern.anchored_begin || text_it == text_end)
+    {
+      break;
+    }
+    text_it = nextCandidate(pattern.prefilter, text_it + 1, text_end);
+  }
+  return MatchResult{};
 }
 
-RecResult match_pattern(const std::string& input_line, const std::string& pattern)
+bool extractCaptures(const CompiledPattern& pattern, MatchScratch& scratch, const char* text_start, const char* text_end,
+  const MatchResult& match)
 {
-  return match_main(input_line.begin(), input_line.end(), pattern.begin(), pattern.end());
+  prepareMatchScratch(scratch, pattern);
+  std::fill(scratch.capture_slots.begin(), scratch.capture_slots.begin() + pattern.slot_count, nullptr);
+  std::uint64_t steps = 0;
+  const size_t memo_stride = resetMemo(pattern, scratch, text_start, text_end);
+
+  MatchResult rerun{};
+  return backtrack(pattern, scratch, text_start, text_end, match.match_start, rerun, steps, memo_stride) == MatchStatus::Match;
 }
 
+RecResult match_pattern(const std::string& input_line, const CompiledPattern& pattern)
+{
+  MatchScratch scratch{};
+  return match_pattern(input_line, pattern, scratch);
+}
 
-int main(int argc, char* argv[])
+RecResult match_pattern(const std::string& input_line, const CompiledPattern& pattern, MatchScratch& scratch)
 {
-  try
-  {
-    if (match_pattern("abc-def is abc-def, not efg, abc, or def", "(([abc]+)-([def]+)) is \\1, not ([^xyz]+), \\2, or \\3").is_valid)
-    {
-      return 0;
-    }
-    else
-    {
-      return 1;
-    }
-  }
-  catch (const std::runtime_error& e)
-  {
-    std::cerr << e.what() << std::endl;
-    return 1;
-  }
+  auto match = match_main(pattern, input_line.data(), input_line.data() + input_line.size(), scratch);
+  return match.status == MatchStatus::Match ? RecResult{ input_line.begin() + (match.match_end - input_line.data()), true } : RecResult{};
+}
+
+RecResult match_pattern(const std::string& input_line, const std::string& pattern)
+{
+  return match_pattern(input_line, compilePattern(pattern));
 }
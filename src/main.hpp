@@ -1,9 +1,14 @@
 #pragma once
 
 #include <string>
-#include <functional>
+#include <string_view>
 #include <vector>
-#include <memory>
+#include <cstdint>
+
+#include "char_set.hpp"
+#include "pattern_allocator.hpp"
+#include "simd_scan.hpp"
+#include "syntax.hpp"
 
 struct RecResult
 {
@@ -11,54 +16,139 @@ struct RecResult
   bool is_valid{ false };
 };
 
-constexpr bool isAnyMetaCharacter(const char c);
-constexpr bool isQuantifier(const char c);
-constexpr bool isQuantifierAdvanced(const char c);
-constexpr bool isCharacterClass(const char c);
-constexpr bool isGroup(const char c);
-constexpr bool is_w(const char c);
-constexpr bool is_W(const char c);
-bool is_d(const char c);
-bool is_D(const char c);
-
-std::function<bool(const char)> characterClassSelector(const char c);
-std::function<bool(const char)> plainCharacterMatcherBuilder(const std::shared_ptr<std::vector<char>>& plainChars);
-
-bool matcherControl(const std::vector<std::function<bool(const char)>>& matchers, const char c);
-std::vector<std::function<bool(const char)>> matcherControlSetupBuilder(std::string::const_iterator pattern_start, std::string::const_iterator pattern_end);
-bool matcherControlSetup(std::string::const_iterator pattern_start, std::string::const_iterator pattern_end, const char c, bool negative_group_flag = false);
-bool matcherControlSetupMemoized(std::vector<std::function<bool(const char)>>& matchers, const char c, bool negative_group_flag = false);
-
-
-RecResult patternControl(std::string::const_iterator text_start, std::string::const_iterator text_end,
-                         std::string::const_iterator pattern_start, std::string::const_iterator pattern_end);
-
+enum class Opcode : std::uint8_t
+{
+  Char,                           // c:   match one literal character
+  Class,                          // x:   match one character against classes[x]
+  Any,                            //      match any character
+  Star,                           // x:   greedily match any run of characters from classes[x]
+  Repeat,                         // x,y,z: greedily match y to z characters from classes[x] (a counted repetition)
+  Split,                          // x,y: try x first, then y
+  Jump,                           // x:   continue at x
+  Save,                           // x:   record the current text position in slot x
+  Progress,                       // x:   fail unless text advanced since slot x was saved (guards empty loops)
+  Backref,                        // x:   match the text captured by group x again
+  AssertBegin,                    //      text position must be the start of the text
+  AssertEnd,                      //      text position must be the end of the text
+  Fail,                           //      never matches (misused meta characters)
+  Match                           // x:   id of the pattern that matched (0 unless built by compilePatterns)
+};
 
-RecResult quantifierLoop(std::string::const_iterator text_start, std::string::const_iterator text_end,
-                         std::string::const_iterator pattern_start, std::string::const_iterator pattern_end,
-                         std::string::const_iterator quantifier_start,
-                         bool negative_group_flag = false, int pattern_end_offset = 0);
+struct Instruction
+{
+  Opcode op{ Opcode::Fail };
+  char c{};
+  int x{};
+  int y{};
+  int z{};
+};
 
-RecResult handleGroups(std::string::const_iterator text_start, std::string::const_iterator text_end,
-                       std::string::const_iterator pattern_start, std::string::const_iterator pattern_end);
+// What a text must contain for the pattern to match, worked out once at compile time.
+struct Prefilter
+{
+  Prefilter() = default;
+  explicit Prefilter(std::pmr::memory_resource* memory)
+    : literal(memory), first_char_list(memory), suffix(memory)
+  {
+  }
+
+  PatternString literal{};                // occurs in every match
+  bool literal_is_prefix{ false };        // ...and every match starts with it
+  ScanSet first_chars{};                  // bytes a match can start with
+  bool has_first_chars{ false };          // false when a match may start anywhere (e.g. it can be empty)
+  PatternString first_char_list{};        // first_chars spelled out when there are at most 3 of them
+  PatternString suffix{};                 // every match ends with it at the very end of the text (`...abc$`)
+  bool ignore_case{ false };              // literal and suffix are lower case and match letters of either case
+};
 
-RecResult match_pattern(const std::string& input_line, const std::string& pattern);
+// Pattern shapes simple enough to be matched by a dedicated kernel instead of an engine (see fast_path.hpp).
+enum class FastPath : std::uint8_t
+{
+  None,
+  Literal,                        // `timeout`: a substring search for prefilter.literal
+  AnchoredLiteral,                // `^GET `: a prefix compare against prefilter.literal
+  ClassRun                        // `\d+`: the first run of prefilter.first_chars, found and measured by vector scans
+};
 
-RecResult match_main(std::string::const_iterator text_start, std::string::const_iterator text_end,
-                     std::string::const_iterator pattern_start, std::string::const_iterator pattern_end);
+// A pattern parsed once into a flat instruction program.
+// Matching a line only walks `program`; it never looks at the pattern text again.
+// Everything it holds is allocated from the memory resource it was compiled with (see compilePattern).
+struct CompiledPattern
+{
+  constexpr CompiledPattern() = default;
+  explicit CompiledPattern(std::pmr::memory_resource* memory)
+    : program(memory), classes(memory), prefilter(memory), memo_row(memory), reversed(memory)
+  {
+  }
+
+  PatternVector<Instruction> program{};
+  PatternVector<CharSet> classes{};
+  int group_count{};
+  int slot_count{};               // 2 per group plus one per guarded loop
+  bool anchored_begin{ false };
+  bool anchored_end{ false };             // every match ends at the end of the text; `reversed` is set
+  bool has_backreferences{ false };   // only the backtracker can run these
+  bool ignore_case{ false };              // -i: letters match either case; set before compiling
+  Prefilter prefilter{};
+  FastPath fast_path{ FastPath::None };
+  // Backtracker memoization (BitState): per pc, its row in the visited bitmap, or -1 when what happens
+  // after pc depends on capture slots (a Backref or loop guard is still reachable) and cannot be cached.
+  PatternVector<int> memo_row{};
+  int memo_rows{};
+  // Sum of the Repeat maxima: the most Repeat threads part way through their count that a thread list
+  // can hold at once (see ThreadList::counts).
+  size_t counted_threads{};
+  // For end-anchored patterns: the same pattern compiled right to left (one element, else empty). Run
+  // backwards from the end of the text it finds the leftmost match start without trying every offset.
+  PatternVector<CompiledPattern> reversed{};
+};
 
-RecResult handleScapedCharacter(std::string::const_iterator text_start, std::string::const_iterator text_end,
-                     std::string::const_iterator pattern_start, std::string::const_iterator pattern_end);
+// With `ignore_case` the captured text matches again in any mix of letter cases.
+bool backReference_match_main(const char* text_start, const char* text_end,
+                              const char* back_ref_start, const char* back_ref_end, bool ignore_case = false);
 
-RecResult group_match_main(std::string::const_iterator text_start, std::string::const_iterator text_end,
-                     std::string::const_iterator pattern_start, std::string::const_iterator pattern_end);
+// With `ignore_case` (-i) letters are folded into the compiled classes, so the text is never lowercased.
+// Everything the result holds is allocated from `memory`, which must outlive it; null means the global heap.
+CompiledPattern compilePattern(const std::string& pattern, bool ignore_case = false, std::pmr::memory_resource* memory = nullptr);
+// Unions several patterns into one program that reports which of them matched: the Match instruction of
+// patterns[i] carries ids[i]. At equal start offsets the earlier pattern wins. Patterns that use back
+// references must be compiled on their own, since group numbers are shared across the union.
+CompiledPattern compilePatterns(const std::vector<std::string>& patterns, const std::vector<int>& ids, bool ignore_case = false,
+  std::pmr::memory_resource* memory = nullptr);
 
-std::string::const_iterator handleQuantifier(std::string::const_iterator quantifier_start, std::string::const_iterator pattern_end, int& min, int& max);
-std::string::const_iterator parseQuantifierRange(int& min, int& max, std::string::const_iterator start, std::string::const_iterator end);
-std::string::const_iterator findOutermostOr(std::string::const_iterator pattern_start, std::string::const_iterator pattern_end);
-std::string::const_iterator findClosingParenthesis(std::string::const_iterator start, std::string::const_iterator end);
+enum class MatchStatus : std::uint8_t
+{
+  NoMatch,
+  Match,
+  BudgetExceeded                  // the backtracker ran out of steps (MatchScratch::step_budget) before deciding
+};
 
-bool backReference_match_main(std::string::const_iterator text_start, std::string::const_iterator text_end,
-                              std::string::const_iterator back_ref_start, std::string::const_iterator back_ref_end);
+struct MatchResult
+{
+  MatchStatus status{ MatchStatus::NoMatch };
+  const char* match_start{};      // set when status == Match
+  const char* match_end{};
+  int pattern{};                  // id of the pattern that matched (see compilePatterns)
+};
 
-RecResult match_pattern(const std::string& input_line, const std::string& pattern);
\ No newline at end of file
+struct MatchScratch;
+
+// Searches [text_start, text_end) for the first match.
+// `scratch` holds the per-search state; give every thread its own. Once it has been prepared for `pattern`
+// (prepareMatchScratch) the search allocates nothing; see MatchScratch::fixed_capacity for the backtracker.
+MatchResult match_main(const CompiledPattern& pattern, const char* text_start, const char* text_end, MatchScratch& scratch);
+// Same, but only matches starting at or after `search_start` count; `^` still means `text_start`.
+MatchResult match_main(const CompiledPattern& pattern, const char* text_start, const char* search_start, const char* text_end,
+  MatchScratch& scratch);
+
+// Fills scratch.capture_slots with the group spans of `match`, a match of `pattern` found by match_main over
+// the same text. Only the matched span is walked again, by the backtracker anchored at its start.
+// Returns false if that run exceeded the step budget.
+bool extractCaptures(const CompiledPattern& pattern, MatchScratch& scratch, const char* text_start, const char* text_end,
+  const MatchResult& match);
+
+// Matches one whole line held in memory. A line too long for that can be fed in blocks to a StreamMatcher
+// (stream_match.hpp), which keeps only the engine state between them.
+RecResult match_pattern(const std::string& input_line, const CompiledPattern& pattern);
+RecResult match_pattern(const std::string& input_line, const CompiledPattern& pattern, MatchScratch& scratch);
+RecResult match_pattern(const std::string& input_line, const std::string& pattern);
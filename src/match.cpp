@@ -0,0 +1,23 @@
+#include "match.hpp"
+
+
+MatchStatus findMatch(const CompiledPattern& pattern, MatchScratch& scratch, const char* text_start, const char* search_start,
+  const char* text_end, bool captures, Match& match)
+{
+  auto result = match_main(pattern, text_start, search_start, text_end, scratch);
+  if (result.status != MatchStatus::Match)
+  {
+    return result.status;
+  }
+  if (captures && !extractCaptures(pattern, scratch, text_start, text_end, result))
+  {
+    return MatchStatus::BudgetExceeded;
+  }
+
+  match.start = result.match_start;
+  match.end = result.match_end;
+  match.pattern = result.pattern;
+  match.captures = captures ? std::span<const char* const>(scratch.capture_slots.data(), 2 * static_cast<size_t>(pattern.group_count))
+    : std::span<const char* const>{};
+  return MatchStatus::Match;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+#include "main.hpp"
+#include "match_scratch.hpp"
+
+// One match in a text: where it starts and ends, which pattern produced it and, when asked for, the spans
+// of its capture groups.
+struct Match
+{
+  const char* start{};
+  const char* end{};
+  int pattern{};
+  // [2 * g] and [2 * g + 1] delimit group g + 1 (nullptr when the group took no part). Points into the
+  // MatchScratch and stays valid until the next search with it; empty unless captures were requested.
+  std::span<const char* const> captures{};
+
+  std::string_view text() const { return { start, static_cast<size_t>(end - start) }; }
+  size_t groupCount() const { return captures.size() / 2; }
+
+  // Group 0 is the whole match; a group that took no part is an empty view with a null data pointer.
+  std::string_view group(size_t index) const
+  {
+    if (index == 0)
+    {
+      return text();
+    }
+    const char* group_start = captures[2 * index - 2];
+    const char* group_end = captures[2 * index - 1];
+    if (group_start == nullptr || group_end == nullptr)
+    {
+      return {};
+    }
+    return { group_start, static_cast<size_t>(group_end - group_start) };
+  }
+};
+
+// First match of `pattern` that starts at or after `search_start` in the text [text_start, text_end).
+// Returns NoMatch, Match (stored in `match`) or BudgetExceeded.
+MatchStatus findMatch(const CompiledPattern& pattern, MatchScratch& scratch, const char* text_start, const char* search_start,
+  const char* text_end, bool captures, Match& match);
+
+// Walks the non-overlapping matches of a text from left to right. Each search resumes where the previous
+// match ended, so the text is scanned once; after an empty match the next one may not start at the same
+// position. `Patterns` is a CompiledPattern or anything else with a findMatch overload (e.g. PatternSet).
+template <typename Patterns>
+class MatchIterator
+{
+public:
+  MatchIterator(const Patterns& patterns, MatchScratch& scratch, std::string_view text, bool captures = false)
+    : patterns_(patterns), scratch_(scratch), text_start_(text.data()), text_it_(text.data()),
+    text_end_(text.data() + text.size()), captures_(captures)
+  {
+  }
+
+  // Stores the next match and returns true; returns false when there are no more. A search that runs out
+  // of the step budget ends the walk and is counted in MatchScratch::budget_exceeded.
+  bool next(Match& match)
+  {
+    if (text_it_ == nullptr)
+    {
+      return false;
+    }
+    auto status = findMatch(patterns_, scratch_, text_start_, text_it_, text_end_, captures_, match);
+    if (status != MatchStatus::Match)
+    {
+      scratch_.budget_exceeded += status == MatchStatus::BudgetExceeded ? 1 : 0;
+      text_it_ = nullptr;
+      return false;
+    }
+    if (match.end != match.start)
+    {
+      text_it_ = match.end;
+    }
+    else
+    {
+      text_it_ = match.end == text_end_ ? nullptr : match.end + 1;
+    }
+    return true;
+  }
+
+private:
+  const Patterns& patterns_;
+  MatchScratch& scratch_;
+  const char* text_start_;
+  const char* text_it_;                   // where the next search starts, nullptr when done
+  const char* text_end_;
+  bool captures_;
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "main.hpp"
+#include "search_stats.hpp"
+
+// Most Repeat threads part way through their count a thread list keeps (see ThreadList::counts). A search
+// that would need more stops, and its caller falls back to an engine that does not track them.
+inline constexpr size_t countedThreadMaxCount = 64 * 1024;
+
+// Ordered set of program counters. `mark` stamps membership with a generation so clearing is O(1).
+struct ThreadList
+{
+  std::vector<int> pcs{};
+  std::vector<const char*> starts{};      // where the attempt that owns pcs[i] began
+  // Characters a Repeat at pcs[i] has matched so far, 0 for any other instruction. A Repeat entered at
+  // different positions is several threads at one pc, told apart by their counts; all of them match or
+  // fail the same character, so they never meet again and only entries with count 0 go through `mark`.
+  std::vector<int> counts{};
+  std::vector<unsigned> mark{};
+  unsigned generation{ 1 };
+  size_t counted{};                       // entries with a count above 0
+  size_t counted_limit{};                 // room reserved for them
+  bool overflowed{ false };               // a counted entry did not fit and was dropped
+
+  void reserve(size_t program_size, size_t counted_threads = 0)
+  {
+    if (mark.size() < program_size)
+    {
+      mark.assign(program_size, 0);
+      generation = 1;
+    }
+    counted_limit = std::max(counted_limit, std::min(counted_threads, countedThreadMaxCount));
+    pcs.reserve(mark.size() + counted_limit);
+    starts.reserve(mark.size() + counted_limit);
+    counts.reserve(mark.size() + counted_limit);
+  }
+
+  void clear()
+  {
+    pcs.clear();
+    starts.clear();
+    counts.clear();
+    counted = 0;
+    overflowed = false;
+    if (++generation == 0)                  // wrapped: stale stamps could alias the new generation
+    {
+      std::fill(mark.begin(), mark.end(), 0);
+      generation = 1;
+    }
+  }
+
+  bool visit(int pc)
+  {
+    if (mark[pc] == generation)
+    {
+      return false;
+    }
+    mark[pc] = generation;
+    return true;
+  }
+
+  void push(int pc, const char* start, int count = 0)
+  {
+    pcs.push_back(pc);
+    starts.push_back(start);
+    counts.push_back(count);
+  }
+
+  // Adds a Repeat thread that has matched `count` (> 0) characters; false when there is no room left.
+  bool pushCounted(int pc, const char* start, int count)
+  {
+    if (counted == counted_limit)
+    {
+      overflowed = true;
+      return false;
+    }
+    ++counted;
+    push(pc, start, count);
+    return true;
+  }
+};
+
+// Choice point of the backtracking VM.
+struct BacktrackFrame
+{
+  enum class Kind : std::uint8_t
+  {
+    Branch,                       // resume at `pc` from `text_it`
+    GiveBack,                     // a Star run: resume at `pc` from `text_it`, then from each shorter run down to `run_start`
+    Restore                       // put `text_it` back into capture slot `pc`
+  };
+
+  Kind kind{};
+  int pc{};
+  const char* text_it{};
+  const char* run_start{};
+};
+
+// PatternSetSearch: the next matching line one engine of the set found.
+struct PatternSetHit
+{
+  std::string_view line{};
+  int pattern_id{};
+  bool searched{ false };                 // `line` is the engine's next hit at or after the current position
+  bool found{ false };
+};
+
+// Everything a search writes while it runs. One per thread: a CompiledPattern is shared read-only.
+// prepareMatchScratch sizes every buffer for a pattern up front, so matching itself never allocates:
+// match_main, findMatch, MatchIterator, PatternSetSearch and nextMatchingLine only write into buffers
+// reserved here. The one buffer whose need depends on the text is the backtracker stack; it grows on
+// demand unless `fixed_capacity` is set.
+struct MatchScratch
+{
+  // Backtracker: [2 * group] = start and [2 * group + 1] = end of each capture, then the loop guards.
+  // A Save restores the previous value when its branch fails, so after a failed attempt the slots are
+  // back to their initial state and the next start offset needs no reset.
+  std::vector<const char*> capture_slots{};
+  std::vector<BacktrackFrame> backtrack_stack{};  // heap-allocated, so deep backtracking cannot overflow the C stack
+  std::vector<std::uint64_t> visited{};          // backtracker: (memo row, offset) states already tried
+  std::uint64_t step_budget{ 0 };                 // backtracker steps allowed per search, 0 = unlimited
+  std::uint64_t budget_exceeded{ 0 };             // searches given up on because of step_budget
+  // Never grow a buffer while matching: a backtracker search that needs a deeper stack than was reserved
+  // (see prepareMatchScratch, or reserve backtrack_stack yourself) ends as BudgetExceeded instead.
+  bool fixed_capacity{ false };
+  ThreadList current_threads{};                   // Pike VM: threads at the current position
+  ThreadList next_threads{};                      // Pike VM: threads at the next position
+  std::vector<int> pending_pcs{};                 // Pike VM: epsilon-closure work stack
+  std::vector<PatternSetHit> set_hits{};          // PatternSetSearch: one per engine of the set
+  SearchStats stats{};                            // --stats counters; only written when statsEnabled
+};
+
+// Largest visited bitmap the backtracker keeps; longer texts run without memoization.
+inline constexpr size_t bitStateMaxBits = 256 * 1024;
+
+// Grows `scratch` to fit `pattern`; a no-op when it already does.
+void prepareMatchScratch(MatchScratch& scratch, const CompiledPattern& pattern);
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Allocator of compiled patterns. It draws from a caller's std::pmr::memory_resource (a pool, an arena),
+// or from the global heap when given none. Unlike std::pmr::polymorphic_allocator it also works during
+// constant evaluation, where it always uses std::allocator, so the compiler that grepcpp::match runs at
+// compile time can keep building into the same containers.
+template <typename T>
+class PatternAllocator
+{
+public:
+  using value_type = T;
+  // A pattern moved into place keeps the storage it was compiled into.
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  constexpr PatternAllocator() noexcept = default;
+  constexpr PatternAllocator(std::pmr::memory_resource* resource) noexcept     // null: the global heap
+    : resource_(resource)
+  {
+  }
+  template <typename U>
+  constexpr PatternAllocator(const PatternAllocator<U>& other) noexcept
+    : resource_(other.resource())
+  {
+  }
+
+  constexpr T* allocate(std::size_t n)
+  {
+    if consteval
+    {
+      return std::allocator<T>{}.allocate(n);
+    }
+    else
+    {
+      if (resource_ == nullptr)
+      {
+        return std::allocator<T>{}.allocate(n);
+      }
+      if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+      {
+        throw std::bad_array_new_length();
+      }
+      return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+    }
+  }
+
+  constexpr void deallocate(T* p, std::size_t n)
+  {
+    if consteval
+    {
+      std::allocator<T>{}.deallocate(p, n);
+    }
+    else
+    {
+      if (resource_ == nullptr)
+      {
+        std::allocator<T>{}.deallocate(p, n);
+        return;
+      }
+      resource_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+  }
+
+  // Like polymorphic_allocator: a copy of a pattern goes to the global heap, not to the source's resource,
+  // which may not outlive it.
+  constexpr PatternAllocator select_on_container_copy_construction() const { return {}; }
+
+  constexpr std::pmr::memory_resource* resource() const noexcept { return resource_; }
+
+  template <typename U>
+  constexpr bool operator==(const PatternAllocator<U>& other) const noexcept { return resource_ == other.resource(); }
+
+private:
+  std::pmr::memory_resource* resource_{};
+};
+
+template <typename T>
+using PatternVector = std::vector<T, PatternAllocator<T>>;
+using PatternString = std::basic_string<char, std::char_traits<char>, PatternAllocator<char>>;
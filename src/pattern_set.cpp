@@ -0,0 +1,220 @@
+#include <algorithm>
+
+#include "pattern_set.hpp"
+#include "line_search.hpp"
+#include "match_scratch.hpp"
+#include "simd_scan.hpp"
+
+
+// The alternatives of a pattern made of literals only, joined by `|` (`timeout`, `cat|dog`), or nothing
+// when it has other meta characters or an empty alternative (which would match everywhere).
+static std::vector<std::string> literalAlternatives(const std::string& pattern)
+{
+  std::vector<std::string> alternatives{};
+  if (pattern.find_first_of("\\.[]()*+?{}^$\n") != std::string::npos)
+  {
+    return alternatives;
+  }
+  for (size_t start = 0; start <= pattern.size(); )
+  {
+    size_t bar = std::min(pattern.find('|', start), pattern.size());
+    if (bar == start)
+    {
+      return {};
+    }
+    alternatives.push_back(pattern.substr(start, bar - start));
+    start = bar + 1;
+  }
+  return alternatives;
+}
+
+PatternSet compilePatternSet(const std::vector<std::string>& patterns, bool ignore_case, std::pmr::memory_resource* memory)
+{
+  // Each alternative of a literal alternation is an automaton entry of its own, under the pattern's id.
+  std::vector<std::string> literals{};
+  std::vector<int> literal_ids{};
+  std::vector<char> is_literal(patterns.size());
+  for (size_t i = 0; i < patterns.size(); ++i)
+  {
+    for (auto& alternative : literalAlternatives(patterns[i]))
+    {
+      literals.push_back(std::move(alternative));
+      literal_ids.push_back(static_cast<int>(i));
+      is_literal[i] = 1;
+    }
+  }
+  // A lone literal is better served by its fast path (a substring search) than by the automaton.
+  const bool use_automaton = literals.size() >= 2;
+
+  PatternSet set(memory);
+  std::vector<std::string> unioned{};
+  std::vector<int> unioned_ids{};
+  std::vector<CompiledPattern> separate{};
+  CompiledPattern single{};
+  for (size_t i = 0; i < patterns.size(); ++i)
+  {
+    if (use_automaton && is_literal[i])
+    {
+      continue;
+    }
+    auto compiled = compilePattern(patterns[i], ignore_case, memory);
+    if (compiled.has_backreferences)
+    {
+      separate.push_back(std::move(compiled));
+      separate.back().program.back().x = static_cast<int>(i);     // the Match instruction carries the id
+    }
+    else
+    {
+      unioned.push_back(patterns[i]);
+      unioned_ids.push_back(static_cast<int>(i));
+      single = std::move(compiled);
+    }
+  }
+
+  if (use_automaton)
+  {
+    set.literals = AhoCorasick(literals, literal_ids, ignore_case, memory);
+    set.literal_program = compilePatterns(literals, literal_ids, ignore_case, memory);
+  }
+  if (unioned.size() == 1)
+  {
+    // Keep compilePattern's own program: the union has nothing to add and would lose end anchoring.
+    single.program.back().x = unioned_ids.front();
+    set.programs.push_back(std::move(single));
+  }
+  else if (!unioned.empty())
+  {
+    set.programs.push_back(compilePatterns(unioned, unioned_ids, ignore_case, memory));
+  }
+  for (auto& compiled : separate)
+  {
+    set.programs.push_back(std::move(compiled));
+  }
+  return set;
+}
+
+void prepareMatchScratch(MatchScratch& scratch, const PatternSet& patterns)
+{
+  for (const auto& compiled : patterns.programs)
+  {
+    prepareMatchScratch(scratch, compiled);
+  }
+  if (!patterns.literals.empty())
+  {
+    prepareMatchScratch(scratch, patterns.literal_program);
+  }
+  scratch.set_hits.reserve(1 + patterns.programs.size());
+}
+
+MatchStatus findMatch(const PatternSet& patterns, MatchScratch& scratch, const char* text_start, const char* search_start,
+  const char* text_end, bool captures, Match& match)
+{
+  const CompiledPattern* best_program = nullptr;
+  MatchResult best{};
+  bool budget_exceeded = false;
+  auto consider = [&](const CompiledPattern& compiled)
+    {
+      auto result = match_main(compiled, text_start, search_start, text_end, scratch);
+      budget_exceeded |= result.status == MatchStatus::BudgetExceeded;
+      if (result.status == MatchStatus::Match && (best_program == nullptr || result.match_start < best.match_start ||
+        (result.match_start == best.match_start && result.pattern < best.pattern)))
+      {
+        best_program = &compiled;
+        best = result;
+      }
+    };
+  if (!patterns.literals.empty())
+  {
+    consider(patterns.literal_program);
+  }
+  for (const auto& compiled : patterns.programs)
+  {
+    consider(compiled);
+  }
+
+  if (best_program == nullptr)
+  {
+    return budget_exceeded ? MatchStatus::BudgetExceeded : MatchStatus::NoMatch;
+  }
+  if (captures && !extractCaptures(*best_program, scratch, text_start, text_end, best))
+  {
+    return MatchStatus::BudgetExceeded;
+  }
+  match.start = best.match_start;
+  match.end = best.match_end;
+  match.pattern = best.pattern;
+  match.captures = captures ? std::span<const char* const>(scratch.capture_slots.data(), 2 * static_cast<size_t>(best_program->group_count))
+    : std::span<const char* const>{};
+  return MatchStatus::Match;
+}
+
+
+PatternSetSearch::PatternSetSearch(const PatternSet& patterns, MatchScratch& scratch, std::string_view buffer)
+  : patterns_(patterns), scratch_(scratch), text_it_(buffer.data()), text_end_(buffer.data() + buffer.size()),
+  hits_(scratch.set_hits)
+{
+  hits_.assign(1 + patterns.programs.size(), PatternSetHit{});
+  hits_[0].searched = patterns.literals.empty();    // no automaton: an engine that never finds anything
+}
+
+void PatternSetSearch::refresh(size_t engine)
+{
+  auto& hit = hits_[engine];
+  hit.searched = true;
+  hit.found = false;
+  if (engine != 0)
+  {
+    const char* text_it = text_it_;
+    hit.found = nextMatchingLine(patterns_.programs[engine - 1], scratch_, text_it, text_end_, hit.line, &hit.pattern_id);
+    return;
+  }
+
+  const char* literal_end = patterns_.literals.find(text_it_, text_end_, hit.pattern_id);
+  if (literal_end == nullptr)
+  {
+    return;
+  }
+  // Literals never contain '\n', so the line holding the hit is the one around its last byte.
+  const char* previous_newline = findLastByte(text_it_, literal_end, '\n');
+  const char* line_start = previous_newline ? previous_newline + 1 : text_it_;
+  const char* line_end = findByte(literal_end, text_end_, '\n');
+  if (line_end == nullptr)
+  {
+    line_end = text_end_;
+  }
+  if (line_start == text_end_)
+  {
+    return;                                         // an empty literal at the very end is not a line
+  }
+  hit.line = std::string_view(line_start, line_end - line_start);
+  hit.found = true;
+}
+
+bool PatternSetSearch::next(std::string_view& line, int& pattern_id)
+{
+  const PatternSetHit* best = nullptr;
+  for (size_t engine = 0; engine < hits_.size(); ++engine)
+  {
+    auto& hit = hits_[engine];
+    if (!hit.searched || (hit.found && hit.line.data() < text_it_))
+    {
+      refresh(engine);
+    }
+    if (hit.found && (best == nullptr || hit.line.data() < best->line.data() ||
+      (hit.line.data() == best->line.data() && hit.pattern_id < best->pattern_id)))
+    {
+      best = &hit;
+    }
+  }
+  if (best == nullptr)
+  {
+    text_it_ = text_end_;
+    return false;
+  }
+
+  line = best->line;
+  pattern_id = best->pattern_id;
+  const char* line_end = line.data() + line.size();
+  text_it_ = line_end == text_end_ ? text_end_ : line_end + 1;
+  return true;
+}
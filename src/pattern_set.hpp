@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aho_corasick.hpp"
+#include "main.hpp"
+#include "match.hpp"
+
+// A -e/-f pattern list, split by the engine that runs each entry fastest. Entries without meta characters
+// other than `|` share one Aho-Corasick automaton (once there are at least two literals in all), a lone
+// literal or other simple shape runs on its fast path (see FastPath), the other entries are unioned
+// into one program, and entries with back references get a program each so they do not push the whole
+// union onto the backtracker. An entry's id is its position in the list.
+struct PatternSet
+{
+  PatternSet() = default;
+  explicit PatternSet(std::pmr::memory_resource* memory)
+    : programs(memory)
+  {
+  }
+
+  AhoCorasick literals{};
+  PatternVector<CompiledPattern> programs{}; // the union first (if any), then one per back-reference entry
+  CompiledPattern literal_program{};        // the automaton's entries as a program, for match positions (-o)
+};
+
+// Throws std::runtime_error when an entry does not compile. `ignore_case` is -i for every entry. Like
+// compilePattern, the set and all its programs are allocated from `memory` (null: the global heap).
+PatternSet compilePatternSet(const std::vector<std::string>& patterns, bool ignore_case = false,
+  std::pmr::memory_resource* memory = nullptr);
+
+void prepareMatchScratch(MatchScratch& scratch, const PatternSet& patterns);
+
+// findMatch (match.hpp) for a whole set: the leftmost match of any entry, the lowest id on a tie.
+MatchStatus findMatch(const PatternSet& patterns, MatchScratch& scratch, const char* text_start, const char* search_start,
+  const char* text_end, bool captures, Match& match);
+
+// Walks the matching lines of one buffer of '\n'-terminated lines, like nextMatchingLine. Every engine of
+// the set searches ahead on its own and keeps its next hit; the earliest hit is the next matching line,
+// so each engine passes over the buffer once. The hits are kept in the scratch, so only one
+// PatternSetSearch may be active per MatchScratch at a time.
+class PatternSetSearch
+{
+public:
+  PatternSetSearch(const PatternSet& patterns, MatchScratch& scratch, std::string_view buffer);
+
+  // Stores the next matching line (without its '\n') and the lowest id among the entries the engines
+  // found on it, and returns true; returns false once the buffer is exhausted.
+  bool next(std::string_view& line, int& pattern_id);
+
+private:
+  void refresh(size_t engine);
+
+  const PatternSet& patterns_;
+  MatchScratch& scratch_;
+  const char* text_it_;
+  const char* text_end_;
+  std::vector<PatternSetHit>& hits_;      // scratch.set_hits: [0] is the literal automaton, [1 + i] is programs[i]
+};
@@ -0,0 +1,255 @@
+#include "pike_vm.hpp"
+#include "prefilter.hpp"
+
+
+// Follows every empty-width instruction reachable from `pc` at position `text_it` and queues the
+// consuming (or Match) instructions in priority order. A `count` above 0 resumes the Repeat at `pc` after
+// that many characters: it keeps counting and, once past its minimum, may also leave with lower priority.
+static void addThread(const CompiledPattern& pattern, ThreadList& list, std::vector<int>& pendingPcs, int pc,
+  const char* text_start, const char* text_end, const char* text_it, const char* thread_start, int count = 0)
+{
+  pendingPcs.clear();
+  if (count > 0)
+  {
+    const auto& repeat = pattern.program[pc];
+    if (count < repeat.z)
+    {
+      list.pushCounted(pc, thread_start, count);    // when full, the caller sees list.overflowed
+    }
+    if (count < repeat.y)
+    {
+      return;
+    }
+    ++pc;
+  }
+  pendingPcs.push_back(pc);
+
+  while (!pendingPcs.empty())
+  {
+    pc = pendingPcs.back();
+    pendingPcs.pop_back();
+    if (!list.visit(pc))
+    {
+      continue;
+    }
+
+    const auto& instruction = pattern.program[pc];
+    switch (instruction.op)
+    {
+    case Opcode::Split:
+      pendingPcs.push_back(instruction.y);          // pushed first so `x` is explored first
+      pendingPcs.push_back(instruction.x);
+      break;
+    case Opcode::Jump:
+      pendingPcs.push_back(instruction.x);
+      break;
+    case Opcode::Save:
+    case Opcode::Progress:                          // empty loops are cut by `visit` instead
+      pendingPcs.push_back(pc + 1);
+      break;
+    case Opcode::AssertBegin:
+      if (text_it == text_start)
+      {
+        pendingPcs.push_back(pc + 1);
+      }
+      break;
+    case Opcode::AssertEnd:
+      if (text_it == text_end)
+      {
+        pendingPcs.push_back(pc + 1);
+      }
+      break;
+    case Opcode::Fail:
+    case Opcode::Backref:                           // never emitted for programs sent here
+      break;
+    case Opcode::Star:                              // consumes and stays, or leaves with lower priority
+      list.push(pc, thread_start);
+      pendingPcs.push_back(pc + 1);
+      break;
+    case Opcode::Repeat:                            // the same, but leaving waits for the minimum count
+      list.push(pc, thread_start);
+      if (instruction.y == 0)
+      {
+        pendingPcs.push_back(pc + 1);
+      }
+      break;
+    case Opcode::Char:
+    case Opcode::Class:
+    case Opcode::Any:
+    case Opcode::Match:
+      list.push(pc, thread_start);
+      break;
+    }
+  }
+}
+
+MatchResult pikeVmSearch(const CompiledPattern& pattern, const char* text_start, const char* search_start, const char* text_end,
+  MatchScratch& scratch)
+{
+  auto& currentThreads = scratch.current_threads;
+  auto& nextThreads = scratch.next_threads;
+  currentThreads.clear();
+  nextThreads.clear();
+  const char* match_start = nullptr;
+  const char* match_end = nullptr;
+  int match_pattern_id = 0;
+
+  for (const char* text_it = search_start; ; ++text_it)
+  {
+    // With no thread alive, skip straight to the next offset the prefilter cannot rule out.
+    if (currentThreads.pcs.empty() && match_end == nullptr && !pattern.anchored_begin)
+    {
+      text_it = nextCandidate(pattern.prefilter, text_it, text_end);
+      if (text_it == nullptr)
+      {
+        break;
+      }
+    }
+
+    // A new attempt starts at every offset until something matched; it has the lowest priority.
+    if (match_end == nullptr && (text_it == text_start || !pattern.anchored_begin))
+    {
+      addThread(pattern, currentThreads, scratch.pending_pcs, 0, text_start, text_end, text_it, text_it);
+      if constexpr (statsEnabled)
+      {
+        ++scratch.stats.start_offsets;
+      }
+    }
+    if constexpr (statsEnabled)
+    {
+      scratch.stats.pike_vm_threads += currentThreads.pcs.size();
+    }
+    if (currentThreads.pcs.empty() && (match_end != nullptr || pattern.anchored_begin))
+    {
+      break;                                        // nothing left that could still match
+    }
+
+    for (size_t thread = 0; thread < currentThreads.pcs.size(); ++thread)
+    {
+      const int pc = currentThreads.pcs[thread];
+      const auto& instruction = pattern.program[pc];
+      bool advances = false;
+      switch (instruction.op)
+      {
+      case Opcode::Char:
+        advances = text_it != text_end && *text_it == instruction.c;
+        break;
+      case Opcode::Class:
+        advances = text_it != text_end && pattern.classes[instruction.x].contains(*text_it);
+        break;
+      case Opcode::Any:
+        advances = text_it != text_end;
+        break;
+      case Opcode::Star:
+      case Opcode::Repeat:
+        advances = text_it != text_end && pattern.classes[instruction.x].contains(*text_it);
+        break;
+      default:                                      // Match
+        break;
+      }
+
+      if (instruction.op == Opcode::Match)
+      {
+        match_start = currentThreads.starts[thread];
+        match_end = text_it;
+        match_pattern_id = instruction.x;
+        break;                                      // lower priority threads can no longer win
+      }
+      if (advances)
+      {
+        int next_pc = instruction.op == Opcode::Star || instruction.op == Opcode::Repeat ? pc : pc + 1;
+        int next_count = instruction.op == Opcode::Repeat ? currentThreads.counts[thread] + 1 : 0;
+        addThread(pattern, nextThreads, scratch.pending_pcs, next_pc, text_start, text_end, text_it + 1, currentThreads.starts[thread],
+          next_count);
+      }
+    }
+
+    if (nextThreads.overflowed)
+    {
+      return MatchResult{ MatchStatus::BudgetExceeded };
+    }
+    if (text_it == text_end)
+    {
+      break;
+    }
+    std::swap(currentThreads, nextThreads);
+    nextThreads.clear();
+  }
+
+  return match_end ? MatchResult{ MatchStatus::Match, match_start, match_end, match_pattern_id } : MatchResult{};
+}
+
+MatchStatus reversePikeVmSearch(const CompiledPattern& reversed, const char* text_start, const char* search_start, const char* text_end,
+  MatchScratch& scratch, const char*& match_start)
+{
+  auto& currentThreads = scratch.current_threads;
+  auto& nextThreads = scratch.next_threads;
+  currentThreads.clear();
+  nextThreads.clear();
+  match_start = nullptr;
+
+  // One attempt, anchored at the end; positions only move left. A thread that reaches Match at `text_it`
+  // means a forward match can start there, and the last such position seen is the leftmost.
+  addThread(reversed, currentThreads, scratch.pending_pcs, 0, text_start, text_end, text_end, text_end);
+  if constexpr (statsEnabled)
+  {
+    ++scratch.stats.start_offsets;
+  }
+  for (const char* text_it = text_end; !currentThreads.pcs.empty(); --text_it)
+  {
+    if constexpr (statsEnabled)
+    {
+      scratch.stats.pike_vm_threads += currentThreads.pcs.size();
+    }
+    for (size_t thread = 0; thread < currentThreads.pcs.size(); ++thread)
+    {
+      const int pc = currentThreads.pcs[thread];
+      const auto& instruction = reversed.program[pc];
+      if (instruction.op == Opcode::Match)
+      {
+        match_start = text_it;
+        continue;
+      }
+      if (text_it == search_start)
+      {
+        continue;                                   // matches may not start further left
+      }
+
+      const char c = text_it[-1];
+      bool advances = false;
+      switch (instruction.op)
+      {
+      case Opcode::Char:
+        advances = c == instruction.c;
+        break;
+      case Opcode::Class:
+      case Opcode::Star:
+      case Opcode::Repeat:
+        advances = reversed.classes[instruction.x].contains(c);
+        break;
+      default:                                      // Any
+        advances = true;
+        break;
+      }
+      if (advances)
+      {
+        int next_pc = instruction.op == Opcode::Star || instruction.op == Opcode::Repeat ? pc : pc + 1;
+        int next_count = instruction.op == Opcode::Repeat ? currentThreads.counts[thread] + 1 : 0;
+        addThread(reversed, nextThreads, scratch.pending_pcs, next_pc, text_start, text_end, text_it - 1, text_end, next_count);
+      }
+    }
+
+    if (nextThreads.overflowed)
+    {
+      return MatchStatus::BudgetExceeded;
+    }
+    if (text_it == search_start)
+    {
+      break;
+    }
+    std::swap(currentThreads, nextThreads);
+    nextThreads.clear();
+  }
+
+  return match_start ? MatchStatus::Match : MatchStatus::NoMatch;
+}
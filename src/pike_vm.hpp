@@ -0,0 +1,22 @@
+#pragma once
+
+#include "main.hpp"
+#include "match_scratch.hpp"
+
+// Thompson/Pike simulation of a compiled program. Every live thread advances in lock step over the text,
+// so a search costs O(text length x program size) regardless of the pattern. Programs that use back
+// references cannot be run this way and stay on the backtracker.
+// Returns the leftmost-first match (the one the backtracker would report), or NoMatch. Returns
+// BudgetExceeded when a counted repetition needs more threads than the scratch keeps (countedThreadMaxCount);
+// the backtracker holds a Repeat's count in one frame and can take over.
+// `scratch` must have been prepared for `pattern`.
+// Attempts start at `search_start`; `text_start` is what `^` matches.
+MatchResult pikeVmSearch(const CompiledPattern& pattern, const char* text_start, const char* search_start, const char* text_end,
+  MatchScratch& scratch);
+
+// Runs a program compiled with `reverse` (CompiledPattern::reversed) backwards from `text_end` and stores
+// the leftmost position in [search_start, text_end] where a forward match ending at `text_end` can start
+// in `match_start`. Every thread is cut as soon as it fails, so text that cannot end a match costs O(suffix).
+// Returns Match, NoMatch, or BudgetExceeded like pikeVmSearch.
+MatchStatus reversePikeVmSearch(const CompiledPattern& reversed, const char* text_start, const char* search_start, const char* text_end,
+  MatchScratch& scratch, const char*& match_start);
@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <vector>
+
+#include "prefilter.hpp"
+#include "simd_scan.hpp"
+
+
+// Larger programs (long counted repetitions) skip the quadratic mandatory-instruction analysis.
+static constexpr size_t maxAnalyzedProgramSize = 2048;
+
+
+static void appendSuccessors(const Instruction& instruction, int pc, std::vector<int>& successors)
+{
+  switch (instruction.op)
+  {
+  case Opcode::Split:
+    successors.push_back(instruction.x);
+    successors.push_back(instruction.y);
+    break;
+  case Opcode::Jump:
+    successors.push_back(instruction.x);
+    break;
+  case Opcode::Fail:
+  case Opcode::Match:
+    break;
+  default:
+    successors.push_back(pc + 1);
+    break;
+  }
+}
+
+// Whether `Match` can be reached from pc 0 without executing `skipped_pc`.
+static bool reachesMatchAvoiding(const CompiledPattern& pattern, int skipped_pc, std::vector<char>& seen, std::vector<int>& pending)
+{
+  std::fill(seen.begin(), seen.end(), 0);
+  pending.assign(1, 0);
+
+  while (!pending.empty())
+  {
+    int pc = pending.back();
+    pending.pop_back();
+    if (pc == skipped_pc || seen[pc])
+    {
+      continue;
+    }
+    seen[pc] = 1;
+    if (pattern.program[pc].op == Opcode::Match)
+    {
+      return true;
+    }
+    appendSuccessors(pattern.program[pc], pc, pending);
+  }
+  return false;
+}
+
+bool literalByte(const CompiledPattern& pattern, const Instruction& instruction, char& c)
+{
+  if (instruction.op == Opcode::Char)
+  {
+    c = instruction.c;
+    return true;
+  }
+  if (!pattern.ignore_case || instruction.op != Opcode::Class)
+  {
+    return false;
+  }
+  const auto& chars = pattern.classes[instruction.x];
+  for (char lower = 'a'; lower <= 'z'; ++lower)
+  {
+    if (chars.contains(lower))
+    {
+      c = lower;
+      return chars == CharSet::single(lower).foldCase();
+    }
+  }
+  return false;
+}
+
+const char* findPrefilterLiteral(const Prefilter& prefilter, const char* text_start, const char* text_end, std::string_view literal)
+{
+  return prefilter.ignore_case ? findLiteralIgnoreCase(text_start, text_end, literal) : findLiteral(text_start, text_end, literal);
+}
+
+// Longest run of consecutive literal characters that every match must contain.
+static void findRequiredLiteral(const CompiledPattern& pattern, Prefilter& prefilter)
+{
+  const int program_size = static_cast<int>(pattern.program.size());
+  std::vector<char> seen(program_size);
+  std::vector<int> pending{};
+
+  std::vector<char> jump_target(program_size + 1);
+  for (int pc = 0; pc < program_size; ++pc)
+  {
+    const auto& instruction = pattern.program[pc];
+    if (instruction.op == Opcode::Split)
+    {
+      jump_target[instruction.x] = jump_target[instruction.y] = 1;
+    }
+    else if (instruction.op == Opcode::Jump)
+    {
+      jump_target[instruction.x] = 1;
+    }
+  }
+
+  int best_start = -1;
+  int best_length = 0;
+  int run_start = -1;
+  char c{};
+  for (int pc = 0; pc <= program_size; ++pc)
+  {
+    // A run continues only through mandatory literal bytes that nothing jumps into.
+    bool extends = pc < program_size && literalByte(pattern, pattern.program[pc], c) &&
+      (run_start == -1 || !jump_target[pc]) && !reachesMatchAvoiding(pattern, pc, seen, pending);
+    if (extends && run_start == -1)
+    {
+      run_start = pc;
+    }
+    else if (!extends && run_start != -1)
+    {
+      if (pc - run_start > best_length)
+      {
+        best_start = run_start;
+        best_length = pc - run_start;
+      }
+      run_start = -1;
+      if (pc < program_size && literalByte(pattern, pattern.program[pc], c))
+      {
+        --pc;                                       // a jump target can still start the next run
+        continue;
+      }
+    }
+  }
+
+  if (best_start == -1)
+  {
+    return;
+  }
+  for (int pc = best_start; pc < best_start + best_length; ++pc)
+  {
+    literalByte(pattern, pattern.program[pc], c);
+    prefilter.literal.push_back(c);
+  }
+
+  int pc = 0;
+  while (pattern.program[pc].op == Opcode::Save)
+  {
+    ++pc;
+  }
+  prefilter.literal_is_prefix = (pc == best_start);
+}
+
+// Bytes the first consumed character of a match can be. Gives up when a match may be empty
+// or may start with something other than a single character.
+static void findFirstChars(const CompiledPattern& pattern, Prefilter& prefilter)
+{
+  std::vector<char> seen(pattern.program.size());
+  std::vector<int> pending{ 0 };
+  CharSet first_chars{};
+
+  while (!pending.empty())
+  {
+    int pc = pending.back();
+    pending.pop_back();
+    if (seen[pc])
+    {
+      continue;
+    }
+    seen[pc] = 1;
+
+    const auto& instruction = pattern.program[pc];
+    switch (instruction.op)
+    {
+    case Opcode::Char:
+      first_chars.insert(instruction.c);
+      break;
+    case Opcode::Class:
+      first_chars |= pattern.classes[instruction.x];
+      break;
+    case Opcode::Star:
+      first_chars |= pattern.classes[instruction.x];
+      pending.push_back(pc + 1);
+      break;
+    case Opcode::Repeat:
+      first_chars |= pattern.classes[instruction.x];
+      if (instruction.y == 0)
+      {
+        pending.push_back(pc + 1);
+      }
+      break;
+    case Opcode::Any:
+    case Opcode::Backref:
+    case Opcode::AssertEnd:
+    case Opcode::Match:
+      return;
+    case Opcode::Fail:
+      break;
+    case Opcode::Split:
+    case Opcode::Jump:
+    case Opcode::Save:
+    case Opcode::Progress:
+    case Opcode::AssertBegin:
+      appendSuccessors(instruction, pc, pending);
+      break;
+    }
+  }
+
+  std::string first_char_list{};
+  for (int byte = 0; byte < 256; ++byte)
+  {
+    if (first_chars.contains(static_cast<char>(byte)))
+    {
+      if (first_char_list.size() == 256 - 1)
+      {
+        return;                                     // every byte can start a match: nothing to skip
+      }
+      first_char_list.push_back(static_cast<char>(byte));
+    }
+  }
+
+  prefilter.first_chars = ScanSet(first_chars);
+  prefilter.has_first_chars = true;
+  if (first_char_list.size() <= 3)
+  {
+    prefilter.first_char_list.assign(first_char_list);
+  }
+}
+
+Prefilter buildPrefilter(const CompiledPattern& pattern)
+{
+  Prefilter prefilter(pattern.program.get_allocator().resource());
+  prefilter.ignore_case = pattern.ignore_case;
+  if (pattern.program.size() <= maxAnalyzedProgramSize)
+  {
+    findRequiredLiteral(pattern, prefilter);
+  }
+  findFirstChars(pattern, prefilter);
+  return prefilter;
+}
+
+
+bool prefilterAccepts(const Prefilter& prefilter, const char* text_start, const char* text_end)
+{
+  const size_t suffix_length = prefilter.suffix.size();
+  if (suffix_length != 0 && (static_cast<size_t>(text_end - text_start) < suffix_length ||
+    findPrefilterLiteral(prefilter, text_end - suffix_length, text_end, prefilter.suffix) == nullptr))
+  {
+    return false;                                   // O(suffix): the text does not end the way every match does
+  }
+  return prefilter.literal.empty() || findPrefilterLiteral(prefilter, text_start, text_end, prefilter.literal) != nullptr;
+}
+
+const char* nextCandidate(const Prefilter& prefilter, const char* text_it, const char* text_end)
+{
+  if (prefilter.literal_is_prefix)
+  {
+    return findPrefilterLiteral(prefilter, text_it, text_end, prefilter.literal);
+  }
+  if (!prefilter.has_first_chars)
+  {
+    return text_it;
+  }
+  if (!prefilter.first_char_list.empty())
+  {
+    return findAnyByte(text_it, text_end, prefilter.first_char_list);
+  }
+  return findInSet(text_it, text_end, prefilter.first_chars);
+}
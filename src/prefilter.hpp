@@ -0,0 +1,20 @@
+#pragma once
+
+#include "main.hpp"
+
+// Derives the literal and first-byte requirements of a compiled program.
+Prefilter buildPrefilter(const CompiledPattern& pattern);
+
+// Whether `instruction` matches exactly one literal byte, stored in `c`. Under ignore_case a class holding
+// just both cases of a letter counts too, as the lower case letter (see Prefilter::ignore_case).
+bool literalByte(const CompiledPattern& pattern, const Instruction& instruction, char& c);
+
+// findLiteral for the prefilter's literal or suffix, honouring Prefilter::ignore_case.
+const char* findPrefilterLiteral(const Prefilter& prefilter, const char* text_start, const char* text_end, std::string_view literal);
+
+// False when the text cannot contain a match at all (a required literal is missing, or the text does not
+// end with the required suffix).
+bool prefilterAccepts(const Prefilter& prefilter, const char* text_start, const char* text_end);
+
+// First position at or after `text_it` where a match could start, or nullptr when there is none.
+const char* nextCandidate(const Prefilter& prefilter, const char* text_it, const char* text_end);
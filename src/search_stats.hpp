@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Hot-path counters behind --stats. They are compiled in only by a build configured with
+// -DGREP_STATS=ON; otherwise statsEnabled is false and every `if constexpr (statsEnabled)` block,
+// clock reads included, disappears from the matching loops.
+#ifdef GREP_STATS
+inline constexpr bool statsEnabled = true;
+#else
+inline constexpr bool statsEnabled = false;
+#endif
+
+// What one worker did. Workers count into their own MatchScratch and the totals are merged at exit.
+struct SearchStats
+{
+  std::uint64_t bytes_scanned{};          // buffer bytes handed to the line search
+  std::uint64_t candidate_lines{};        // lines the buffer-level prefilter could not rule out
+  std::uint64_t prefilter_rejects{};      // ... of which match_main's prefilter check rejected at once
+  std::uint64_t matching_lines{};
+  std::uint64_t start_offsets{};          // offsets a new match attempt started at
+  std::uint64_t pike_vm_threads{};        // Pike VM thread steps, summed over text positions
+  std::uint64_t counted_fallbacks{};      // Pike VM searches handed to the backtracker (countedThreadMaxCount)
+  std::uint64_t backtrack_steps{};        // instructions the backtracker executed
+  std::uint64_t max_backtrack_depth{};    // deepest backtrack stack (the recursion depth of a recursive matcher)
+  std::uint64_t capture_saves{};          // capture slot writes by the backtracker
+  std::chrono::nanoseconds io_time{};     // waiting for input: reads and decompression not yet caught up
+  std::chrono::nanoseconds prefilter_time{};    // buffer-level candidate search
+  std::chrono::nanoseconds engine_time{};       // running the matching engines on candidate lines
+  std::vector<std::uint64_t> pattern_lines{};   // matching lines per pattern id
+
+  void merge(const SearchStats& other)
+  {
+    bytes_scanned += other.bytes_scanned;
+    candidate_lines += other.candidate_lines;
+    prefilter_rejects += other.prefilter_rejects;
+    matching_lines += other.matching_lines;
+    start_offsets += other.start_offsets;
+    pike_vm_threads += other.pike_vm_threads;
+    counted_fallbacks += other.counted_fallbacks;
+    backtrack_steps += other.backtrack_steps;
+    max_backtrack_depth = std::max(max_backtrack_depth, other.max_backtrack_depth);
+    capture_saves += other.capture_saves;
+    io_time += other.io_time;
+    prefilter_time += other.prefilter_time;
+    engine_time += other.engine_time;
+    pattern_lines.resize(std::max(pattern_lines.size(), other.pattern_lines.size()));
+    for (size_t i = 0; i < other.pattern_lines.size(); ++i)
+    {
+      pattern_lines[i] += other.pattern_lines[i];
+    }
+  }
+};
+
+// Adds the time since `since` to `total` and restarts `since`.
+inline void addElapsed(std::chrono::nanoseconds& total, std::chrono::steady_clock::time_point& since)
+{
+  auto now = std::chrono::steady_clock::now();
+  total += now - since;
+  since = now;
+}
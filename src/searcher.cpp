@@ -0,0 +1,100 @@
+#include "searcher.hpp"
+
+
+// Flags and pattern list as a cache key: every entry prefixed with its length, so no two lists share a key.
+static std::string cacheKey(const std::vector<std::string>& patterns, bool ignore_case)
+{
+  std::string key(ignore_case ? "i" : "-");
+  for (const auto& pattern : patterns)
+  {
+    key += std::to_string(pattern.size());
+    key += ':';
+    key += pattern;
+  }
+  return key;
+}
+
+static size_t memoryUsage(const CompiledPattern& pattern)
+{
+  size_t bytes = sizeof(CompiledPattern) + pattern.program.capacity() * sizeof(Instruction) + pattern.classes.capacity() * sizeof(CharSet)
+    + pattern.memo_row.capacity() * sizeof(int) + pattern.prefilter.literal.capacity() + pattern.prefilter.first_char_list.capacity()
+    + pattern.prefilter.suffix.capacity();
+  for (const auto& reversed : pattern.reversed)
+  {
+    bytes += memoryUsage(reversed);
+  }
+  return bytes;
+}
+
+// Estimated heap footprint of a compiled set; what the memory budget is charged for it.
+static size_t memoryUsage(const PatternSet& patterns)
+{
+  size_t bytes = sizeof(PatternSet) + patterns.literals.memoryUsage() + memoryUsage(patterns.literal_program);
+  for (const auto& program : patterns.programs)
+  {
+    bytes += memoryUsage(program);
+  }
+  return bytes;
+}
+
+
+Searcher::Searcher(size_t memory_budget)
+  : memory_budget_(memory_budget)
+{
+}
+
+std::shared_ptr<const PatternSet> Searcher::patternSet(const std::vector<std::string>& patterns, bool ignore_case)
+{
+  auto key = cacheKey(patterns, ignore_case);
+  {
+    std::lock_guard lock(mutex_);
+    auto found = index_.find(key);
+    if (found != index_.end())
+    {
+      entries_.splice(entries_.begin(), entries_, found->second);
+      ++stats_.hits;
+      return found->second->patterns;
+    }
+    ++stats_.misses;
+  }
+
+  // Compile without holding the lock; should another thread race us to the same key, its copy is kept.
+  auto compiled = std::make_shared<const PatternSet>(compilePatternSet(patterns, ignore_case));
+  const size_t bytes = key.capacity() + memoryUsage(*compiled);
+
+  std::lock_guard lock(mutex_);
+  auto found = index_.find(key);
+  if (found != index_.end())
+  {
+    return found->second->patterns;
+  }
+  if (bytes > memory_budget_)
+  {
+    return compiled;                                // would evict everything else and still not fit
+  }
+  entries_.push_front(Entry{ key, compiled, bytes });
+  index_.emplace(std::move(key), entries_.begin());
+  stats_.bytes += bytes;
+  ++stats_.entries;
+  evictOverBudget();
+  return compiled;
+}
+
+void Searcher::evictOverBudget()
+{
+  while (stats_.bytes > memory_budget_ && !entries_.empty())
+  {
+    auto& oldest = entries_.back();
+    stats_.bytes -= oldest.bytes;
+    --stats_.entries;
+    ++stats_.evictions;
+    index_.erase(oldest.key);
+    entries_.pop_back();
+  }
+}
+
+Searcher::CacheStats Searcher::cacheStats() const
+{
+  std::lock_guard lock(mutex_);
+  return stats_;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pattern_set.hpp"
+
+// Keeps compiled pattern sets for a long-running process that searches with the same patterns again
+// and again (the server behind `grep --daemon`, or a program linking the engine). Sets are keyed by their
+// pattern list and compile flags; once their estimated size passes the memory budget the least recently
+// used ones are evicted. One Searcher may be shared by any number of threads.
+class Searcher
+{
+public:
+  static constexpr size_t defaultMemoryBudget = 64 * 1024 * 1024;
+
+  struct CacheStats
+  {
+    size_t entries{};
+    size_t bytes{};
+    std::uint64_t hits{};
+    std::uint64_t misses{};
+    std::uint64_t evictions{};
+  };
+
+  explicit Searcher(size_t memory_budget = defaultMemoryBudget);
+
+  // The compiled form of `patterns`, compiled on first use. A set stays valid for as long as the caller
+  // holds it, even if the cache evicts it meanwhile. Throws std::runtime_error like compilePatternSet.
+  std::shared_ptr<const PatternSet> patternSet(const std::vector<std::string>& patterns, bool ignore_case = false);
+
+  CacheStats cacheStats() const;
+
+private:
+  struct Entry
+  {
+    std::string key{};
+    std::shared_ptr<const PatternSet> patterns{};
+    size_t bytes{};
+  };
+
+  void evictOverBudget();
+
+  size_t memory_budget_;
+  std::list<Entry> entries_{};                    // most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_{};
+  CacheStats stats_{};
+  mutable std::mutex mutex_{};
+};
@@ -0,0 +1,403 @@
+#include <cstring>
+
+#include "simd_scan.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define GREP_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+
+const char* findByte(const char* text_start, const char* text_end, const char needle)
+{
+  // glibc already ships SSE2/AVX2/EVEX memchr variants selected at load time.
+  return static_cast<const char*>(std::memchr(text_start, needle, text_end - text_start));
+}
+
+const char* findLastByte(const char* text_start, const char* text_end, const char needle)
+{
+  return static_cast<const char*>(::memrchr(text_start, needle, text_end - text_start));
+}
+
+ScanSet::ScanSet(const CharSet& set)
+  : chars(set)
+{
+  for (int byte = 0; byte < 256; ++byte)
+  {
+    if (set.contains(static_cast<char>(byte)))
+    {
+      auto& table = byte < 0x80 ? low_table : high_table;
+      table[byte & 15] |= static_cast<std::uint8_t>(1u << ((byte >> 4) & 7));
+    }
+  }
+}
+
+
+static size_t countByteScalar(const char* text_start, const char* text_end, const char needle)
+{
+  size_t count = 0;
+  for (; text_start != text_end; ++text_start)
+  {
+    count += (*text_start == needle);
+  }
+  return count;
+}
+
+// First byte whose membership in `chars` is `wanted`.
+static const char* findInSetScalar(const char* text_start, const char* text_end, const CharSet& chars, bool wanted)
+{
+  for (; text_start != text_end; ++text_start)
+  {
+    if (chars.contains(*text_start) == wanted)
+    {
+      return text_start;
+    }
+  }
+  return nullptr;
+}
+
+static const char* findAnyByteScalar(const char* text_start, const char* text_end, std::string_view needles)
+{
+  for (; text_start != text_end; ++text_start)
+  {
+    if (needles.find(*text_start) != std::string_view::npos)
+    {
+      return text_start;
+    }
+  }
+  return nullptr;
+}
+
+// Candidate check for literals: compare the first byte, then the last, then the rest.
+static const char* findLiteralScalar(const char* text_start, const char* text_end, std::string_view literal)
+{
+  const size_t length = literal.size();
+  while (text_end - text_start >= static_cast<std::ptrdiff_t>(length))
+  {
+    auto candidate = findByte(text_start, text_end - length + 1, literal.front());
+    if (candidate == nullptr)
+    {
+      return nullptr;
+    }
+    if (candidate[length - 1] == literal.back() && std::memcmp(candidate + 1, literal.data() + 1, length - 1) == 0)
+    {
+      return candidate;
+    }
+    text_start = candidate + 1;
+  }
+  return nullptr;
+}
+
+static bool equalIgnoreCase(const char* text, const char* lower_literal, size_t length)
+{
+  for (size_t i = 0; i < length; ++i)
+  {
+    if (toLowerAscii(text[i]) != lower_literal[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// findLiteralScalar for a lower case literal whose letters may appear in either case in the text.
+static const char* findLiteralIgnoreCaseScalar(const char* text_start, const char* text_end, std::string_view literal)
+{
+  const size_t length = literal.size();
+  for (; text_end - text_start >= static_cast<std::ptrdiff_t>(length); ++text_start)
+  {
+    if (toLowerAscii(*text_start) == literal.front() && equalIgnoreCase(text_start, literal.data(), length))
+    {
+      return text_start;
+    }
+  }
+  return nullptr;
+}
+
+
+#ifdef GREP_SIMD_X86
+
+static const char* findAnyByteSse2(const char* text_start, const char* text_end, std::string_view needles)
+{
+  const __m128i first = _mm_set1_epi8(needles[0]);
+  const __m128i second = _mm_set1_epi8(needles[needles.size() > 1 ? 1 : 0]);
+  const __m128i third = _mm_set1_epi8(needles[needles.size() > 2 ? 2 : 0]);
+
+  for (; text_end - text_start >= 16; text_start += 16)
+  {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text_start));
+    const __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, first), _mm_cmpeq_epi8(block, second)),
+      _mm_cmpeq_epi8(block, third));
+    if (int mask = _mm_movemask_epi8(hits))
+    {
+      return text_start + __builtin_ctz(mask);
+    }
+  }
+  return findAnyByteScalar(text_start, text_end, needles);
+}
+
+__attribute__((target("avx2")))
+static const char* findAnyByteAvx2(const char* text_start, const char* text_end, std::string_view needles)
+{
+  const __m256i first = _mm256_set1_epi8(needles[0]);
+  const __m256i second = _mm256_set1_epi8(needles[needles.size() > 1 ? 1 : 0]);
+  const __m256i third = _mm256_set1_epi8(needles[needles.size() > 2 ? 2 : 0]);
+
+  for (; text_end - text_start >= 32; text_start += 32)
+  {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text_start));
+    const __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, first), _mm256_cmpeq_epi8(block, second)),
+      _mm256_cmpeq_epi8(block, third));
+    if (unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits)))
+    {
+      return text_start + __builtin_ctz(mask);
+    }
+  }
+  return findAnyByteSse2(text_start, text_end, needles);
+}
+
+// Set membership of 32 bytes at a time: the shuffles look up each byte's table entry (a byte with its top
+// bit set reads 0 from the table it does not belong to) and the bit its high nibble selects. SSE2 has
+// no byte shuffle, so below AVX2 the scalar loop runs.
+__attribute__((target("avx2")))
+static const char* findInSetAvx2(const char* text_start, const char* text_end, const ScanSet& set, bool wanted)
+{
+  const __m256i low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(set.low_table.data())));
+  const __m256i high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(set.high_table.data())));
+  const __m256i bit_table = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+    1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+  const __m256i top_bit = _mm256_set1_epi8(-128);
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  const unsigned flip = wanted ? 0u : ~0u;
+
+  for (; text_end - text_start >= 32; text_start += 32)
+  {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text_start));
+    const __m256i rows = _mm256_or_si256(_mm256_shuffle_epi8(low_table, block),
+      _mm256_shuffle_epi8(high_table, _mm256_xor_si256(block, top_bit)));
+    const __m256i bits = _mm256_shuffle_epi8(bit_table, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble));
+    const __m256i hits = _mm256_cmpeq_epi8(_mm256_and_si256(rows, bits), bits);
+    if (unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits)) ^ flip)
+    {
+      return text_start + __builtin_ctz(mask);
+    }
+  }
+  return findInSetScalar(text_start, text_end, set.chars, wanted);
+}
+
+static size_t countByteSse2(const char* text_start, const char* text_end, const char needle)
+{
+  const __m128i wanted = _mm_set1_epi8(needle);
+  size_t count = 0;
+  for (; text_end - text_start >= 16; text_start += 16)
+  {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text_start));
+    count += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, wanted)))));
+  }
+  return count + countByteScalar(text_start, text_end, needle);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t countByteAvx2(const char* text_start, const char* text_end, const char needle)
+{
+  const __m256i wanted = _mm256_set1_epi8(needle);
+  size_t count = 0;
+  for (; text_end - text_start >= 32; text_start += 32)
+  {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text_start));
+    count += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, wanted)))));
+  }
+  return count + countByteSse2(text_start, text_end, needle);
+}
+
+// Generic SIMD substring search: a block position is a candidate when both the literal's first byte
+// and its last byte line up; only candidates are verified with memcmp.
+static const char* findLiteralSse2(const char* text_start, const char* text_end, std::string_view literal)
+{
+  const size_t length = literal.size();
+  const __m128i first = _mm_set1_epi8(literal.front());
+  const __m128i last = _mm_set1_epi8(literal.back());
+
+  for (; text_end - text_start >= static_cast<std::ptrdiff_t>(length + 15); text_start += 16)
+  {
+    const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text_start));
+    const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text_start + length - 1));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last))));
+    while (mask != 0)
+    {
+      const char* candidate = text_start + __builtin_ctz(mask);
+      if (std::memcmp(candidate + 1, literal.data() + 1, length - 2) == 0)
+      {
+        return candidate;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return findLiteralScalar(text_start, text_end, literal);
+}
+
+__attribute__((target("avx2")))
+static const char* findLiteralAvx2(const char* text_start, const char* text_end, std::string_view literal)
+{
+  const size_t length = literal.size();
+  const __m256i first = _mm256_set1_epi8(literal.front());
+  const __m256i last = _mm256_set1_epi8(literal.back());
+
+  for (; text_end - text_start >= static_cast<std::ptrdiff_t>(length + 31); text_start += 32)
+  {
+    const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text_start));
+    const __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text_start + length - 1));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last))));
+    while (mask != 0)
+    {
+      const char* candidate = text_start + __builtin_ctz(mask);
+      if (std::memcmp(candidate + 1, literal.data() + 1, length - 2) == 0)
+      {
+        return candidate;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return findLiteralSse2(text_start, text_end, literal);
+}
+
+static bool isLowerAscii(const char c)
+{
+  return c >= 'a' && c <= 'z';
+}
+
+// The first/last byte filter of findLiteralSse2 on case-folded blocks: OR-ing in 0x20 maps an upper case
+// letter onto its lower case, and is only applied to the positions compared against a letter.
+static const char* findLiteralIgnoreCaseSse2(const char* text_start, const char* text_end, std::string_view literal)
+{
+  const size_t length = literal.size();
+  const __m128i first = _mm_set1_epi8(literal.front());
+  const __m128i last = _mm_set1_epi8(literal.back());
+  const __m128i first_fold = _mm_set1_epi8(isLowerAscii(literal.front()) ? 0x20 : 0);
+  const __m128i last_fold = _mm_set1_epi8(isLowerAscii(literal.back()) ? 0x20 : 0);
+
+  for (; text_end - text_start >= static_cast<std::ptrdiff_t>(length + 15); text_start += 16)
+  {
+    const __m128i block_first = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text_start)), first_fold);
+    const __m128i block_last = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text_start + length - 1)), last_fold);
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last))));
+    while (mask != 0)
+    {
+      const char* candidate = text_start + __builtin_ctz(mask);
+      if (equalIgnoreCase(candidate, literal.data(), length))
+      {
+        return candidate;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return findLiteralIgnoreCaseScalar(text_start, text_end, literal);
+}
+
+__attribute__((target("avx2")))
+static const char* findLiteralIgnoreCaseAvx2(const char* text_start, const char* text_end, std::string_view literal)
+{
+  const size_t length = literal.size();
+  const __m256i first = _mm256_set1_epi8(literal.front());
+  const __m256i last = _mm256_set1_epi8(literal.back());
+  const __m256i first_fold = _mm256_set1_epi8(isLowerAscii(literal.front()) ? 0x20 : 0);
+  const __m256i last_fold = _mm256_set1_epi8(isLowerAscii(literal.back()) ? 0x20 : 0);
+
+  for (; text_end - text_start >= static_cast<std::ptrdiff_t>(length + 31); text_start += 32)
+  {
+    const __m256i block_first = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text_start)), first_fold);
+    const __m256i block_last = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text_start + length - 1)), last_fold);
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last))));
+    while (mask != 0)
+    {
+      const char* candidate = text_start + __builtin_ctz(mask);
+      if (equalIgnoreCase(candidate, literal.data(), length))
+      {
+        return candidate;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return findLiteralIgnoreCaseSse2(text_start, text_end, literal);
+}
+
+static bool detectAvx2()
+{
+  __builtin_cpu_init();                   // required before __builtin_cpu_supports during static initialization
+  return __builtin_cpu_supports("avx2");
+}
+
+static const bool cpuHasAvx2 = detectAvx2();
+
+#endif
+
+
+const char* findAnyByte(const char* text_start, const char* text_end, std::string_view needles)
+{
+  if (needles.size() == 1)
+  {
+    return findByte(text_start, text_end, needles.front());
+  }
+#ifdef GREP_SIMD_X86
+  return cpuHasAvx2 ? findAnyByteAvx2(text_start, text_end, needles) : findAnyByteSse2(text_start, text_end, needles);
+#else
+  return findAnyByteScalar(text_start, text_end, needles);
+#endif
+}
+
+const char* findInSet(const char* text_start, const char* text_end, const ScanSet& set)
+{
+#ifdef GREP_SIMD_X86
+  return cpuHasAvx2 ? findInSetAvx2(text_start, text_end, set, true) : findInSetScalar(text_start, text_end, set.chars, true);
+#else
+  return findInSetScalar(text_start, text_end, set.chars, true);
+#endif
+}
+
+const char* findNotInSet(const char* text_start, const char* text_end, const ScanSet& set)
+{
+#ifdef GREP_SIMD_X86
+  return cpuHasAvx2 ? findInSetAvx2(text_start, text_end, set, false) : findInSetScalar(text_start, text_end, set.chars, false);
+#else
+  return findInSetScalar(text_start, text_end, set.chars, false);
+#endif
+}
+
+size_t countByte(const char* text_start, const char* text_end, const char needle)
+{
+#ifdef GREP_SIMD_X86
+  return cpuHasAvx2 ? countByteAvx2(text_start, text_end, needle) : countByteSse2(text_start, text_end, needle);
+#else
+  return countByteScalar(text_start, text_end, needle);
+#endif
+}
+
+const char* findLiteral(const char* text_start, const char* text_end, std::string_view literal)
+{
+  if (literal.empty())
+  {
+    return text_start;
+  }
+  if (literal.size() == 1)
+  {
+    return findByte(text_start, text_end, literal.front());
+  }
+#ifdef GREP_SIMD_X86
+  return cpuHasAvx2 ? findLiteralAvx2(text_start, text_end, literal) : findLiteralSse2(text_start, text_end, literal);
+#else
+  return findLiteralScalar(text_start, text_end, literal);
+#endif
+}
+
+const char* findLiteralIgnoreCase(const char* text_start, const char* text_end, std::string_view lower_literal)
+{
+  if (lower_literal.empty())
+  {
+    return text_start;
+  }
+#ifdef GREP_SIMD_X86
+  return cpuHasAvx2 ? findLiteralIgnoreCaseAvx2(text_start, text_end, lower_literal) : findLiteralIgnoreCaseSse2(text_start, text_end, lower_literal);
+#else
+  return findLiteralIgnoreCaseScalar(text_start, text_end, lower_literal);
+#endif
+}
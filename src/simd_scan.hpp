@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "char_set.hpp"
+
+// A CharSet laid out for findInSet and findNotInSet. Bytes below 0x80 are looked up in `low_table`, the
+// rest in `high_table`: bit (b >> 4) & 7 of table[b & 15] is set when byte b is in the set. Vector code
+// finds 16 or 32 entries at once with a byte shuffle. Build it once, when the set is known.
+struct ScanSet
+{
+  CharSet chars{};
+  std::array<std::uint8_t, 16> low_table{};
+  std::array<std::uint8_t, 16> high_table{};
+
+  ScanSet() = default;
+  explicit ScanSet(const CharSet& set);
+};
+
+// Vectorized byte and substring scanners. On x86-64 each one uses AVX2 when the CPU has it and SSE2
+// otherwise (picked at run time); other targets get portable scalar loops.
+// All of them return the first position in [text_start, text_end) that matches, or nullptr.
+
+const char* findByte(const char* text_start, const char* text_end, const char needle);
+const char* findLastByte(const char* text_start, const char* text_end, const char needle);        // last match instead of first
+const char* findAnyByte(const char* text_start, const char* text_end, std::string_view needles);      // 1 to 3 needles
+size_t countByte(const char* text_start, const char* text_end, const char needle);                  // occurrences of needle
+const char* findInSet(const char* text_start, const char* text_end, const ScanSet& set);
+const char* findNotInSet(const char* text_start, const char* text_end, const ScanSet& set);          // first byte outside the set
+const char* findLiteral(const char* text_start, const char* text_end, std::string_view literal);
+const char* findLiteralIgnoreCase(const char* text_start, const char* text_end, std::string_view lower_literal);    // -i; ASCII letters only
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+#include "compiler.hpp"
+
+// Matchers for patterns known at build time, in the style of ctre:
+//
+//   if (auto m = grepcpp::match<"(\\w+)@(\\w+)">(address)) { use(m.group(1), m.group(2)); }
+//
+// The pattern goes through the regular compiler (compiler.hpp) during constant evaluation, so a bad pattern
+// is a compile error. The program becomes a constant array and every instruction its own function template,
+// so the optimizer sees straight-line code with all characters, classes and jump targets folded in. Nothing
+// is parsed, allocated or dispatched through a pointer at run time.
+//
+// Like the run-time backtracker this explores alternatives depth first (leftmost-first results, back
+// references allowed), recursing once per group-loop iteration. It is meant for short inputs such as request
+// fields; untrusted long texts belong on match_main, whose Pike VM and step budget bound the work.
+namespace grepcpp
+{
+
+// A string literal usable as a template argument.
+template <std::size_t N>
+struct FixedString
+{
+  char text[N]{};
+
+  constexpr FixedString(const char (&literal)[N])
+  {
+    std::copy_n(literal, N, text);
+  }
+
+  constexpr std::string_view view() const { return { text, N - 1 }; }
+};
+
+// Result of match/search: the matched text and the text of each group (empty when it did not take part).
+template <std::size_t Groups>
+struct StaticMatch
+{
+  bool matched{ false };
+  std::array<std::string_view, Groups + 1> groups{};      // [0] is the whole match
+
+  constexpr explicit operator bool() const { return matched; }
+  constexpr std::string_view group(std::size_t index) const { return groups[index]; }
+  constexpr std::string_view text() const { return groups[0]; }
+};
+
+namespace detail
+{
+
+template <FixedString Pattern, bool WholeText>
+constexpr CompiledPattern compileStatic()
+{
+  CompiledPattern compiled{};
+  int next_group = 0;
+  const std::string pattern(Pattern.view());
+  compileAlternation(compiled, pattern.begin(), pattern.end(), next_group);
+  if (WholeText)
+  {
+    emit(compiled, Opcode::AssertEnd);
+  }
+  emit(compiled, Opcode::Match);
+  resolveLoopGuards(compiled, next_group);
+  return compiled;
+}
+
+// A CompiledPattern frozen into fixed-size arrays so it can live in a constexpr variable.
+template <std::size_t ProgramSize, std::size_t ClassCount>
+struct StaticProgram
+{
+  std::array<Instruction, ProgramSize> program{};
+  std::array<CharSet, ClassCount> classes{};
+  int group_count{};
+  int slot_count{};
+  bool anchored_begin{ false };
+};
+
+template <FixedString Pattern, bool WholeText>
+inline constexpr auto staticProgram = []
+  {
+    constexpr auto sizes = []
+      {
+        auto compiled = compileStatic<Pattern, WholeText>();
+        return std::array<std::size_t, 2>{ compiled.program.size(), compiled.classes.size() };
+      }();
+
+    auto compiled = compileStatic<Pattern, WholeText>();
+    StaticProgram<sizes[0], sizes[1]> frozen{};
+    std::copy(compiled.program.begin(), compiled.program.end(), frozen.program.begin());
+    std::copy(compiled.classes.begin(), compiled.classes.end(), frozen.classes.begin());
+    frozen.group_count = compiled.group_count;
+    frozen.slot_count = compiled.slot_count;
+    frozen.anchored_begin = compiled.anchored_begin;
+    return frozen;
+  }();
+
+template <const auto& Program>
+struct StaticMatcher
+{
+  struct State
+  {
+    const char* text_start{};
+    const char* text_end{};
+    const char* match_end{};
+    std::array<const char*, static_cast<std::size_t>(Program.slot_count)> slots{};
+  };
+
+  // Runs the program from `Pc` at `text_it`; the same instruction semantics as the run-time backtracker.
+  template <int Pc>
+  static constexpr bool run(State& state, const char* text_it)
+  {
+    constexpr Instruction instruction = Program.program[Pc];
+
+    if constexpr (instruction.op == Opcode::Char)
+    {
+      return text_it != state.text_end && *text_it == instruction.c && run<Pc + 1>(state, text_it + 1);
+    }
+    else if constexpr (instruction.op == Opcode::Class)
+    {
+      return text_it != state.text_end && Program.classes[instruction.x].contains(*text_it) && run<Pc + 1>(state, text_it + 1);
+    }
+    else if constexpr (instruction.op == Opcode::Any)
+    {
+      return text_it != state.text_end && run<Pc + 1>(state, text_it + 1);
+    }
+    else if constexpr (instruction.op == Opcode::Star)
+    {
+      const char* run_end = text_it;
+      while (run_end != state.text_end && Program.classes[instruction.x].contains(*run_end))
+      {
+        ++run_end;
+      }
+      for (;; --run_end)                            // greedy: longest run first, then give back
+      {
+        if (run<Pc + 1>(state, run_end))
+        {
+          return true;
+        }
+        if (run_end == text_it)
+        {
+          return false;
+        }
+      }
+    }
+    else if constexpr (instruction.op == Opcode::Repeat)
+    {
+      const char* run_end = text_it;
+      while (run_end != state.text_end && run_end - text_it < instruction.z && Program.classes[instruction.x].contains(*run_end))
+      {
+        ++run_end;
+      }
+      for (; run_end - text_it >= instruction.y; --run_end)
+      {
+        if (run<Pc + 1>(state, run_end))
+        {
+          return true;
+        }
+        if (run_end == text_it)
+        {
+          break;
+        }
+      }
+      return false;
+    }
+    else if constexpr (instruction.op == Opcode::Split)
+    {
+      return run<instruction.x>(state, text_it) || run<instruction.y>(state, text_it);
+    }
+    else if constexpr (instruction.op == Opcode::Jump)
+    {
+      return run<instruction.x>(state, text_it);
+    }
+    else if constexpr (instruction.op == Opcode::Save)
+    {
+      const char* previous = state.slots[instruction.x];
+      state.slots[instruction.x] = text_it;
+      if (run<Pc + 1>(state, text_it))
+      {
+        return true;
+      }
+      state.slots[instruction.x] = previous;
+      return false;
+    }
+    else if constexpr (instruction.op == Opcode::Progress)
+    {
+      return state.slots[instruction.x] != text_it && run<Pc + 1>(state, text_it);
+    }
+    else if constexpr (instruction.op == Opcode::Backref)
+    {
+      const char* back_ref_start = state.slots[2 * instruction.x];
+      const char* back_ref_end = state.slots[2 * instruction.x + 1];
+      if (back_ref_start == nullptr || back_ref_end == nullptr || state.text_end - text_it < back_ref_end - back_ref_start)
+      {
+        return false;
+      }
+      for (const char* it = back_ref_start; it != back_ref_end; ++it, ++text_it)
+      {
+        if (*it != *text_it)
+        {
+          return false;
+        }
+      }
+      return run<Pc + 1>(state, text_it);
+    }
+    else if constexpr (instruction.op == Opcode::AssertBegin)
+    {
+      return text_it == state.text_start && run<Pc + 1>(state, text_it);
+    }
+    else if constexpr (instruction.op == Opcode::AssertEnd)
+    {
+      return text_it == state.text_end && run<Pc + 1>(state, text_it);
+    }
+    else if constexpr (instruction.op == Opcode::Match)
+    {
+      state.match_end = text_it;
+      return true;
+    }
+    else                                            // Fail
+    {
+      return false;
+    }
+  }
+
+  static constexpr StaticMatch<Program.group_count> find(std::string_view text, bool whole_text)
+  {
+    State state{ text.data(), text.data() + text.size() };
+    StaticMatch<Program.group_count> result{};
+    for (const char* text_it = state.text_start; ; ++text_it)
+    {
+      if (run<0>(state, text_it))
+      {
+        result.matched = true;
+        result.groups[0] = std::string_view(text_it, state.match_end - text_it);
+        for (int group = 0; group < Program.group_count; ++group)
+        {
+          const char* group_start = state.slots[2 * group];
+          const char* group_end = state.slots[2 * group + 1];
+          if (group_start != nullptr && group_end != nullptr)
+          {
+            result.groups[group + 1] = std::string_view(group_start, group_end - group_start);
+          }
+        }
+        return result;
+      }
+      if (whole_text || Program.anchored_begin || text_it == state.text_end)
+      {
+        return result;
+      }
+    }
+  }
+};
+
+} // namespace detail
+
+// Matches `Pattern` against the whole of `text`.
+template <FixedString Pattern>
+constexpr auto match(std::string_view text)
+{
+  return detail::StaticMatcher<detail::staticProgram<Pattern, true>>::find(text, true);
+}
+
+// Finds the leftmost-first match of `Pattern` anywhere in `text`, as grep does for a line.
+template <FixedString Pattern>
+constexpr auto search(std::string_view text)
+{
+  return detail::StaticMatcher<detail::staticProgram<Pattern, false>>::find(text, false);
+}
+
+} // namespace grepcpp
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "stream_match.hpp"
+#include "simd_scan.hpp"
+
+
+// Follows every empty-width instruction reachable from `pc` and adds the consuming ones to `list`, like
+// the Pike VM's addThread (`count` included). Returns true when a Match is reachable. `at_begin` and
+// `at_end` say whether the position is the start or the end of the line; the end is only known once the
+// line is finished.
+static bool follow(const CompiledPattern& pattern, ThreadList& list, std::vector<int>& pendingPcs, int pc, bool at_begin, bool at_end,
+  int count = 0)
+{
+  bool reached = false;
+  pendingPcs.clear();
+  if (count > 0)
+  {
+    const auto& repeat = pattern.program[pc];
+    if (count < repeat.z)
+    {
+      list.pushCounted(pc, nullptr, count);         // room for every count was reserved (see add)
+    }
+    if (count < repeat.y)
+    {
+      return false;
+    }
+    ++pc;
+  }
+  pendingPcs.push_back(pc);
+
+  while (!pendingPcs.empty())
+  {
+    pc = pendingPcs.back();
+    pendingPcs.pop_back();
+    if (!list.visit(pc))
+    {
+      continue;
+    }
+
+    const auto& instruction = pattern.program[pc];
+    switch (instruction.op)
+    {
+    case Opcode::Split:
+      pendingPcs.push_back(instruction.y);
+      pendingPcs.push_back(instruction.x);
+      break;
+    case Opcode::Jump:
+      pendingPcs.push_back(instruction.x);
+      break;
+    case Opcode::Save:
+    case Opcode::Progress:
+      pendingPcs.push_back(pc + 1);
+      break;
+    case Opcode::AssertBegin:
+      if (at_begin)
+      {
+        pendingPcs.push_back(pc + 1);
+      }
+      break;
+    case Opcode::AssertEnd:
+      if (at_end)
+      {
+        pendingPcs.push_back(pc + 1);
+      }
+      break;
+    case Opcode::Fail:
+    case Opcode::Backref:                           // refused by the constructor
+      break;
+    case Opcode::Match:
+      reached = true;
+      break;
+    case Opcode::Star:
+      list.push(pc, nullptr);
+      pendingPcs.push_back(pc + 1);
+      break;
+    case Opcode::Repeat:
+      list.push(pc, nullptr);
+      if (instruction.y == 0)
+      {
+        pendingPcs.push_back(pc + 1);
+      }
+      break;
+    case Opcode::Char:
+    case Opcode::Class:
+    case Opcode::Any:
+      list.push(pc, nullptr);
+      break;
+    }
+  }
+  return reached;
+}
+
+
+StreamMatcher::StreamMatcher(const CompiledPattern& pattern)
+{
+  add(pattern);
+}
+
+StreamMatcher::StreamMatcher(const PatternSet& patterns)
+{
+  if (!patterns.literal_program.program.empty())
+  {
+    add(patterns.literal_program);
+  }
+  for (const auto& program : patterns.programs)
+  {
+    add(program);
+  }
+}
+
+void StreamMatcher::add(const CompiledPattern& pattern)
+{
+  if (pattern.has_backreferences)
+  {
+    throw std::runtime_error("back references cannot be matched across blocks");
+  }
+  if (pattern.counted_threads > countedThreadMaxCount)
+  {
+    throw std::runtime_error("counted repetition too long to be matched across blocks");
+  }
+  Program program{ &pattern };
+  program.seeds.reserve(pattern.program.size(), pattern.counted_threads);
+  program.threads.reserve(pattern.program.size(), pattern.counted_threads);
+  programs_.push_back(std::move(program));
+  pending_pcs_.reserve(std::max(pending_pcs_.capacity(), 2 * pattern.program.size() + 1));
+}
+
+void StreamMatcher::feed(std::string_view piece)
+{
+  if (piece.empty())
+  {
+    return;
+  }
+  const char* line_start = line_started_ ? nullptr : piece.data();
+  for (auto& program : programs_)
+  {
+    if (matched_)
+    {
+      break;
+    }
+    if (!program.done)
+    {
+      feed(program, line_start, piece.data(), piece.data() + piece.size());
+    }
+  }
+  line_started_ = true;
+}
+
+// One program over one piece. `line_start` is the piece's first byte when it starts the line, else null.
+void StreamMatcher::feed(Program& program, const char* line_start, const char* text_it, const char* text_end)
+{
+  const auto& pattern = *program.pattern;
+  for (; text_it != text_end; ++text_it)
+  {
+    if (program.seeds.pcs.empty())
+    {
+      // No attempt alive: an anchored program is over, any other skips to the next byte a match can start with.
+      if (pattern.anchored_begin && text_it != line_start)
+      {
+        program.done = true;
+        return;
+      }
+      if (!pattern.anchored_begin && pattern.prefilter.has_first_chars)
+      {
+        text_it = findInSet(text_it, text_end, pattern.prefilter.first_chars);
+        if (text_it == nullptr)
+        {
+          return;
+        }
+      }
+    }
+
+    const bool at_begin = text_it == line_start;
+    bool reached = false;
+    program.threads.clear();
+    for (size_t seed = 0; seed < program.seeds.pcs.size(); ++seed)
+    {
+      reached |= follow(pattern, program.threads, pending_pcs_, program.seeds.pcs[seed], at_begin, false, program.seeds.counts[seed]);
+    }
+    if (!pattern.anchored_begin || at_begin)
+    {
+      reached |= follow(pattern, program.threads, pending_pcs_, 0, at_begin, false);
+    }
+    if (reached)
+    {
+      matched_ = true;
+      return;
+    }
+
+    program.seeds.clear();
+    const char c = *text_it;
+    for (size_t thread = 0; thread < program.threads.pcs.size(); ++thread)
+    {
+      const int pc = program.threads.pcs[thread];
+      const auto& instruction = pattern.program[pc];
+      bool advances = false;
+      switch (instruction.op)
+      {
+      case Opcode::Char:
+        advances = c == instruction.c;
+        break;
+      case Opcode::Class:
+      case Opcode::Star:
+      case Opcode::Repeat:
+        advances = pattern.classes[instruction.x].contains(c);
+        break;
+      default:                                      // Any
+        advances = true;
+        break;
+      }
+      if (advances && instruction.op == Opcode::Repeat)
+      {
+        program.seeds.pushCounted(pc, nullptr, program.threads.counts[thread] + 1);
+        continue;
+      }
+      const int next_pc = instruction.op == Opcode::Star ? pc : pc + 1;
+      if (advances && program.seeds.visit(next_pc))
+      {
+        program.seeds.push(next_pc, nullptr);
+      }
+    }
+  }
+}
+
+bool StreamMatcher::finish()
+{
+  bool result = matched_;
+  const bool at_begin = !line_started_;
+  for (auto& program : programs_)
+  {
+    if (!result && !program.done)
+    {
+      const auto& pattern = *program.pattern;
+      program.threads.clear();
+      for (size_t seed = 0; seed < program.seeds.pcs.size(); ++seed)
+      {
+        result |= follow(pattern, program.threads, pending_pcs_, program.seeds.pcs[seed], at_begin, true, program.seeds.counts[seed]);
+      }
+      if (!pattern.anchored_begin || at_begin)
+      {
+        result |= follow(pattern, program.threads, pending_pcs_, 0, at_begin, true);
+      }
+    }
+    program.seeds.clear();
+    program.done = false;
+  }
+  line_started_ = false;
+  matched_ = false;
+  return result;
+}
+
+
+bool canStream(const PatternSet& patterns)
+{
+  for (const auto& program : patterns.programs)
+  {
+    if (program.has_backreferences || program.counted_threads > countedThreadMaxCount)
+    {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "main.hpp"
+#include "match_scratch.hpp"
+#include "pattern_set.hpp"
+
+// Decides whether a line matches without ever holding the whole line: the line is fed in pieces of any
+// size, and all that carries from one piece to the next is the set of Pike VM threads alive at the
+// boundary. Memory is O(program size) however long the line grows, so a multi-GB line with no '\n' can
+// be matched from fixed-size blocks. Only a yes/no answer comes out; there are no match positions.
+// The constructor sizes every buffer, so feed and finish never allocate.
+// Patterns with back references, or with counted repetitions needing more than countedThreadMaxCount
+// threads, cannot be matched this way (see canStream).
+class StreamMatcher
+{
+public:
+  // Throws std::runtime_error when the pattern (or an entry of the set) cannot be streamed.
+  explicit StreamMatcher(const CompiledPattern& pattern);
+  explicit StreamMatcher(const PatternSet& patterns);
+
+  // Appends the next piece of the current line, which does not include the line's '\n'.
+  void feed(std::string_view piece);
+  // True as soon as the line is known to match; whatever is left of it need not be fed.
+  bool matched() const { return matched_; }
+  // Ends the current line and returns whether it matched; the next feed starts a new line.
+  bool finish();
+
+private:
+  struct Program
+  {
+    const CompiledPattern* pattern{};
+    ThreadList seeds{};                   // pcs to resume at the next byte, before their empty-width closure
+    ThreadList threads{};                 // the closure at the current byte: consuming instructions only
+    bool done{ false };                   // anchored at the line start and every thread died
+  };
+
+  void add(const CompiledPattern& pattern);
+  void feed(Program& program, const char* line_start, const char* text_it, const char* text_end);
+
+  std::vector<Program> programs_{};
+  std::vector<int> pending_pcs_{};
+  bool line_started_{ false };            // a byte of the current line has been fed
+  bool matched_{ false };
+};
+
+// Whether every engine of the set can run under a StreamMatcher.
+bool canStream(const PatternSet& patterns);
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "char_set.hpp"
+
+// Pattern syntax helpers. They are constexpr so the same code parses patterns at run time (compilePattern)
+// and at compile time (grepcpp::match); a syntax error thrown during constant evaluation becomes a
+// compile error.
+
+constexpr bool isAnyMetaCharacter(const char c)
+{
+  return (
+    (c == '^') ||
+    (c == '$') ||
+
+    (c == '[') ||
+    (c == ']') ||
+    (c == '(') ||
+    (c == ')') ||
+
+    (c == '{') ||
+    (c == '}') ||
+
+    (c == '+') ||
+    (c == '*') ||
+    (c == '?') ||
+
+    (c == '.') ||
+
+    (c == '\\') ||
+
+    (c == '|')
+    );
+}
+
+constexpr bool isQuantifier(const char c)
+{
+  return (
+    (c == '+') ||
+    (c == '*') ||
+    (c == '?')
+    );
+}
+
+constexpr bool isQuantifierAdvanced(const char c)
+{
+  return (
+    (c == '+') ||
+    (c == '*') ||
+    (c == '?') ||
+    (c == '{')
+    );
+}
+
+constexpr bool isCharacterClass(const char c)
+{
+  return (
+    (c == 'w') ||
+    (c == 'W') ||
+    (c == 's') ||
+    (c == 'S') ||
+    (c == 'd') ||
+    (c == 'D') ||
+    (c == 'w') ||
+    (c == 'W') ||
+    (c == 'x') ||
+    (c == 'O') ||
+    (c == 'c')
+    );
+}
+
+constexpr bool isGroup(const char c)
+{
+  return (
+    (c == '[') ||
+    (c == ']') ||
+    (c == '(') ||
+    (c == ')')
+    );
+}
+
+
+constexpr const CharSet& characterClassSelector(const char c)
+{
+  switch (c)
+  {
+  case 'w':
+    return wordCharSet;
+    break;
+  case 'W':
+    return nonWordCharSet;
+    break;
+  case 'd':
+    return digitCharSet;
+    break;
+  case 'D':
+    return nonDigitCharSet;
+    break;
+  case 's':
+    return spaceCharSet;
+    break;
+  case 'S':
+    return nonSpaceCharSet;
+    break;
+
+  default:
+    throw std::invalid_argument("Character Class must receive valid character");
+    break;
+  }
+}
+
+
+constexpr CharSet charSetBuilder(std::string::const_iterator pattern_start, std::string::const_iterator pattern_end)
+{
+  CharSet chars{};
+
+  while (pattern_start != pattern_end)
+  {
+    if (*pattern_start == '.')                      // Early exit if sub_pattern contains `.`
+    {
+      return anyCharSet;
+    }
+    else if (*pattern_start == '\\')                // handle scape character
+    {
+      if (pattern_start + 1 == pattern_end)
+      {
+        throw std::invalid_argument("Error: Dangling backslash.");
+      }
+      else if (isCharacterClass(*(pattern_start + 1)))
+      {
+        chars |= characterClassSelector(*(pattern_start + 1));
+      }
+      else
+      {
+        chars.insert(*(pattern_start + 1));
+      }
+      pattern_start += 2;
+    }
+    else                                            // plain character
+    {
+      chars.insert(*pattern_start);
+      ++pattern_start;
+    }
+  }
+
+  return chars;
+}
+
+
+// Parses one bound of a {n,m} quantifier, ignoring blanks. Returns false when it holds anything but digits.
+constexpr bool parseQuantifierBound(std::string::const_iterator start, std::string::const_iterator end, bool& empty, int& value)
+{
+  empty = true;
+  value = 0;
+  for (; start != end; ++start)
+  {
+    const char c = *start;
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r')
+    {
+      continue;
+    }
+    if (c < '0' || c > '9')
+    {
+      return false;
+    }
+    if (value > (0x7fffffff - (c - '0')) / 10)
+    {
+      throw std::out_of_range("Quantifier bound too large");
+    }
+    value = value * 10 + (c - '0');
+    empty = false;
+  }
+  return true;
+}
+
+constexpr std::string::const_iterator parseQuantifierRange(int& min, int& max, std::string::const_iterator start, std::string::const_iterator end)
+{
+  const auto new_end = std::find(start, end, '}');
+  if (new_end == end)
+  {
+    throw std::runtime_error("Closing '}' not found");
+  }
+
+  auto comma = std::find(start, new_end, ',');
+
+  // Parse the first number (min)
+  bool empty{};
+  if (!parseQuantifierBound(start, comma, empty, min) || empty)
+  {
+    throw std::runtime_error("Invalid number format for min");
+  }
+
+  if (comma == new_end)
+  {
+    // No comma found, max = min
+    max = min;
+  }
+  else
+  {
+    // Comma found, parse the second number (max)
+    if (!parseQuantifierBound(comma + 1, new_end, empty, max))
+    {
+      throw std::runtime_error("Invalid number format for max");
+    }
+    else if (empty)
+    {
+      // Empty value between ',' and '}'
+      max = -1;
+    }
+  }
+
+  // Ensure min <= max, except when max is -1
+  if (max != -1 && min > max)
+  {
+    throw std::runtime_error("Min cannot be greater than max");
+  }
+
+  return new_end + 1;
+}
+
+
+constexpr std::string::const_iterator findOutermostOr(std::string::const_iterator pattern_start, std::string::const_iterator pattern_end)
+{
+  std::vector<char> brackets;
+
+  for (; pattern_start != pattern_end; ++pattern_start) {
+    switch (*pattern_start) {
+    case '(':
+    case '[':
+      brackets.push_back(*pattern_start);
+      break;
+    case ')':
+      if (!brackets.empty() && brackets.back() == '(') {
+        brackets.pop_back();
+      }
+      break;
+    case ']':
+      if (!brackets.empty() && brackets.back() == '[') {
+        brackets.pop_back();
+      }
+      break;
+    case '|':
+      if (brackets.empty()) {
+        return pattern_start;  // Found outermost '|'
+      }
+      break;
+    }
+  }
+
+  return pattern_end;  // No outermost '|' found
+}
+
+constexpr std::string::const_iterator findClosingParenthesis(std::string::const_iterator start, std::string::const_iterator end)
+{
+  int scope = 0;
+  bool foundOpeningParenthesis = false;
+
+  for (auto it = start; it != end; ++it)
+  {
+    if (*it == '(')
+    {
+      scope++;
+      foundOpeningParenthesis = true;
+    }
+    else if (*it == ')')
+    {
+      if (!foundOpeningParenthesis)
+      {
+        throw std::runtime_error("Closing parenthesis found before opening parenthesis");
+      }
+      scope--;
+      if (scope == 0)
+      {
+        return it;  // Found the closing parenthesis in the same scope
+      }
+    }
+  }
+
+  if (!foundOpeningParenthesis)
+  {
+    throw std::runtime_error("No opening parenthesis found");
+  }
+  else
+  {
+    throw std::runtime_error("Unmatched opening parenthesis: scope never closed");
+  }
+}
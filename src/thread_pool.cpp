@@ -0,0 +1,95 @@
+#include "thread_pool.hpp"
+
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+  if (thread_count == 0)
+  {
+    thread_count = 1;
+  }
+  for (size_t i = 0; i < thread_count; ++i)
+  {
+    queues_.push_back(std::make_unique<WorkerQueue>());
+  }
+  for (size_t i = 0; i < thread_count; ++i)
+  {
+    threads_.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard lock(wake_mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& thread : threads_)
+  {
+    thread.join();
+  }
+}
+
+void ThreadPool::submit(Task task)
+{
+  auto& queue = *queues_[next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size()];
+  {
+    std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard lock(wake_mutex_);
+    queued_.fetch_add(1, std::memory_order_release);
+  }
+  wake_.notify_one();
+}
+
+bool ThreadPool::takeTask(size_t worker, Task& task)
+{
+  {
+    auto& own = *queues_[worker];
+    std::lock_guard lock(own.mutex);
+    if (!own.tasks.empty())
+    {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  for (size_t offset = 1; offset < queues_.size(); ++offset)
+  {
+    auto& victim = *queues_[(worker + offset) % queues_.size()];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.tasks.empty())
+    {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::workerLoop(size_t worker)
+{
+  Task task{};
+  while (true)
+  {
+    if (takeTask(worker, task))
+    {
+      task(worker);
+      task = nullptr;
+      continue;
+    }
+
+    std::unique_lock lock(wake_mutex_);
+    wake_.wait(lock, [this] { return stopping_ || queued_.load(std::memory_order_acquire) > 0; });
+    if (stopping_ && queued_.load(std::memory_order_acquire) == 0)
+    {
+      return;
+    }
+  }
+}
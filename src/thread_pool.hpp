@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool where every worker owns a task queue. A worker takes its newest task first and,
+// when its own queue is empty, steals the oldest task of another worker.
+// Tasks receive the index of the worker running them so they can use per-worker state.
+class ThreadPool
+{
+public:
+  using Task = std::function<void(size_t worker)>;
+
+  explicit ThreadPool(size_t thread_count);
+  ~ThreadPool();                                  // runs every queued task, then joins
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void submit(Task task);
+  size_t size() const { return threads_.size(); }
+
+private:
+  struct WorkerQueue
+  {
+    std::mutex mutex{};
+    std::deque<Task> tasks{};
+  };
+
+  bool takeTask(size_t worker, Task& task);
+  void workerLoop(size_t worker);
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_{};
+  std::vector<std::thread> threads_{};
+  std::mutex wake_mutex_{};
+  std::condition_variable wake_{};
+  std::atomic<size_t> queued_{ 0 };
+  std::atomic<size_t> next_queue_{ 0 };
+  bool stopping_{ false };
+};
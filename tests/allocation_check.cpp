@@ -0,0 +1,145 @@
+// Checks that matching allocates nothing once a pattern is compiled and its scratch prepared.
+//
+// For every corpus and pattern of the benchmark matrix, the pattern is compiled into an arena, a scratch is
+// prepared and fixed in size, and the heap allocations made while it runs over a sample of the corpus are
+// counted, separately for PatternSetSearch, MatchIterator without and with captures, and StreamMatcher.
+// Any count above 0 is printed and fails the test.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "allocation_counter.hpp"
+#include "corpus.hpp"
+#include "main.hpp"
+#include "match.hpp"
+#include "match_scratch.hpp"
+#include "pattern_set.hpp"
+#include "stream_match.hpp"
+
+
+// Whether every form of operator new goes through the counter; a check that counts nothing proves nothing.
+static bool counterSeesEveryNew()
+{
+  const std::uint64_t before = allocationCount();
+  ::operator delete(::operator new(1));
+  ::operator delete[](::operator new[](1));
+  ::operator delete(::operator new(1, std::align_val_t{ 64 }), std::align_val_t{ 64 });
+  ::operator delete[](::operator new[](1, std::align_val_t{ 64 }), std::align_val_t{ 64 });
+  ::operator delete(::operator new(1, std::nothrow));
+  ::operator delete[](::operator new[](1, std::nothrow));
+  return allocationCount() - before == 6;
+}
+
+// The heap allocations made while `pattern_case` runs over the start of the corpus through each matching
+// API. Only the matching is counted; compiling, preparing the scratch and constructing the StreamMatcher
+// happen before. Returns false, after printing the counts, when anything allocated.
+static bool allocationFree(const Corpus& corpus, const PatternCase& pattern_case)
+{
+  std::string_view sample(corpus.text.data(), std::min<size_t>(corpus.text.size(), 64 * 1024));
+
+  std::pmr::monotonic_buffer_resource arena{};
+  auto patterns = compilePatternSet({ pattern_case.pattern }, false, &arena);
+  auto pattern = compilePattern(pattern_case.pattern, false, &arena);
+  MatchScratch scratch{};
+  prepareMatchScratch(scratch, patterns);
+  prepareMatchScratch(scratch, pattern);
+  scratch.step_budget = 1'000'000;
+  scratch.fixed_capacity = true;
+  std::optional<StreamMatcher> stream{};
+  if (canStream(patterns))
+  {
+    stream.emplace(patterns);
+  }
+
+  std::uint64_t counts[4]{};
+  std::uint64_t allocations_before = allocationCount();
+  {
+    PatternSetSearch search(patterns, scratch, sample);
+    std::string_view line{};
+    int pattern_id{};
+    while (search.next(line, pattern_id))
+    {
+    }
+  }
+  counts[0] = allocationCount() - allocations_before;
+
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    allocations_before = allocationCount();
+    const bool captures = pass == 1;
+    for (size_t line_start = 0; line_start < sample.size(); )
+    {
+      size_t line_end = std::min(sample.find('\n', line_start), sample.size());
+      MatchIterator<CompiledPattern> matches(pattern, scratch, sample.substr(line_start, line_end - line_start), captures);
+      Match match{};
+      while (matches.next(match))
+      {
+      }
+      line_start = line_end + 1;
+    }
+    counts[1 + pass] = allocationCount() - allocations_before;
+  }
+
+  allocations_before = allocationCount();
+  if (stream)
+  {
+    for (size_t line_start = 0; line_start < sample.size(); )
+    {
+      size_t line_end = std::min(sample.find('\n', line_start), sample.size());
+      for (size_t piece = line_start; piece < line_end && !stream->matched(); piece += 4096)
+      {
+        stream->feed(sample.substr(piece, std::min<size_t>(4096, line_end - piece)));
+      }
+      stream->finish();
+      line_start = line_end + 1;
+    }
+  }
+  counts[3] = allocationCount() - allocations_before;
+
+  if (counts[0] + counts[1] + counts[2] + counts[3] == 0)
+  {
+    return true;
+  }
+  std::string label = corpus.name + "/" + pattern_case.name;
+  std::fprintf(stderr, "%-40s allocated while matching: search %llu, iterate %llu, captures %llu, stream %llu\n", label.c_str(),
+    static_cast<unsigned long long>(counts[0]), static_cast<unsigned long long>(counts[1]),
+    static_cast<unsigned long long>(counts[2]), static_cast<unsigned long long>(counts[3]));
+  return false;
+}
+
+int main()
+{
+  if (!counterSeesEveryNew())
+  {
+    std::fprintf(stderr, "allocation counter is not in use\n");
+    return 1;
+  }
+
+  const size_t corpus_size = 256 * 1024;
+  std::vector<Corpus> corpora{};
+  corpora.push_back(apacheLog(corpus_size, 20));
+  corpora.push_back(apacheLog(corpus_size, 5000));
+  corpora.push_back(jsonLog(corpus_size));
+  corpora.push_back(longLines(corpus_size));
+  corpora.push_back(adversarial(corpus_size));
+
+  int failures = 0;
+  int checks = 0;
+  for (const auto& corpus : corpora)
+  {
+    for (const auto& pattern_case : patternCases)
+    {
+      failures += allocationFree(corpus, pattern_case) ? 0 : 1;
+      ++checks;
+    }
+  }
+  std::printf("%d of %d corpus/pattern pairs allocated while matching\n", failures, checks);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+#!/bin/sh
+# Checks that a NUL byte makes a file binary however the file is read: mapped whole, split into chunks
+# searched in parallel (-j), read from a pipe in blocks, or decompressed in blocks. The NUL sits far
+# before the last match, in an earlier block or chunk than the match, and far enough after the first
+# match that the first one is still printed.
+#
+# Usage: binary_detection.sh EXE [gz]     (gz: EXE decompresses gzip, so the .gz path is checked too)
+
+set -u
+exe=$1
+check_gzip=${2:-}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+filler='the quick brown fox jumps over the lazy dog 0123456789'
+{
+  echo 'needle one'
+  yes "$filler" | head -n 4000
+  printf 'hello\0world\n'
+  yes "$filler" | head -n 800000           # 44 MB: large enough to be split into chunks
+  echo 'needle two'
+} > "$dir/input"
+
+failures=0
+expect()
+{
+  name=$1
+  shift
+  "$@" > "$dir/out" 2> "$dir/err"
+  if [ "$(cat "$dir/out")" != 'needle one' ] || ! grep -q 'binary file matches' "$dir/err"; then
+    echo "$name: expected 'needle one' then a binary file match, got:"
+    cat "$dir/out" "$dir/err"
+    failures=$((failures + 1))
+  fi
+}
+
+expect mapped "$exe" -j 1 needle "$dir/input"
+expect chunks "$exe" -j 8 needle "$dir/input"
+expect pipe sh -c 'cat "$1" | "$2" needle' sh "$dir/input" "$exe"
+if [ "$check_gzip" = gz ]; then
+  gzip -c "$dir/input" > "$dir/input.gz"
+  expect gzip "$exe" needle "$dir/input.gz"
+fi
+
+exit $((failures != 0))
@@ -0,0 +1,158 @@
+#!/bin/sh
+# Checks -A/-B/-C context lines with their "--" group separators, -c counts and -l names, and which of
+# -c and -l wins, against the expected output on small generated files. Then checks the same options,
+# with and without -j, on a file large enough to be split into chunks, against grep.
+#
+# Usage: context_and_counts.sh EXE
+
+set -u
+exe=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+printf '%s\n' alpha 'match one' beta gamma delta 'match two' 'match three' epsilon zeta eta theta 'match four' > s1
+printf '%s\n' 'match five' x y z 'w match six' > s2
+printf '%s\n' nothing here > s3
+
+failures=0
+# expect OPTIONS...: EXE OPTIONS prints exactly the lines on standard input.
+expect()
+{
+  cat > expected
+  "$exe" "$@" > actual 2>&1
+  if ! cmp -s expected actual; then
+    echo "$*: output differs from the expected:"
+    diff expected actual | head -n 10
+    failures=$((failures + 1))
+  fi
+}
+
+expect -n -C 1 match s1 s2 <<'END'
+s1-1-alpha
+s1:2:match one
+s1-3-beta
+--
+s1-5-delta
+s1:6:match two
+s1:7:match three
+s1-8-epsilon
+--
+s1-11-theta
+s1:12:match four
+--
+s2:1:match five
+s2-2-x
+--
+s2-4-z
+s2:5:w match six
+END
+
+expect -A 1 match s1 s2 <<'END'
+s1:match one
+s1-beta
+--
+s1:match two
+s1:match three
+s1-epsilon
+--
+s1:match four
+--
+s2:match five
+s2-x
+--
+s2:w match six
+END
+
+expect -n -B 2 match s1 s2 <<'END'
+s1-1-alpha
+s1:2:match one
+--
+s1-4-gamma
+s1-5-delta
+s1:6:match two
+s1:7:match three
+--
+s1-10-eta
+s1-11-theta
+s1:12:match four
+--
+s2:1:match five
+--
+s2-3-y
+s2-4-z
+s2:5:w match six
+END
+
+expect -C 1 match s1 <<'END'
+alpha
+match one
+beta
+--
+delta
+match two
+match three
+epsilon
+--
+theta
+match four
+END
+
+expect -c match s1 s2 s3 <<'END'
+s1:4
+s2:2
+s3:0
+END
+
+expect -l match s1 s2 s3 <<'END'
+s1
+s2
+END
+
+# -l wins over -c, and neither prints context.
+expect -c -l match s1 s2 s3 <<'END'
+s1
+s2
+END
+
+expect -C 2 -c match s1 s2 s3 <<'END'
+s1:4
+s2:2
+s3:0
+END
+
+expect -n -A 3 -l match s1 s3 <<'END'
+s1
+END
+
+# About 39 MB, so -j splits it into chunks of 16 MiB. Matches sit every 50000 lines and on the lines
+# around each 16 MiB boundary, where the chunks are cut.
+awk 'BEGIN {
+  bytes = 0
+  for (i = 1; i <= 1000000; ++i) {
+    line = sprintf("row %07d lorem ipsum dolor sit amet", i)
+    boundary = int((bytes + length(line) + 1) / 16777216) != int(bytes / 16777216)
+    if (i % 50000 == 0 || boundary || near > 0) {
+      line = line " match"
+      near = boundary ? 2 : near - 1
+    }
+    print line
+    bytes += length(line) + 1
+  }
+}' > large
+
+for options in '-n match' '-c match' '-l match' '-n -C 2 match' '-b -B 3 match' '-A 1 -c match'; do
+  # shellcheck disable=SC2086
+  grep $options large > expected
+  for jobs in 1 8; do
+    # shellcheck disable=SC2086
+    "$exe" -j "$jobs" $options large > actual 2>&1
+    if ! cmp -s expected actual; then
+      echo "-j $jobs $options on a chunked file: output differs from grep:"
+      diff expected actual | head -n 10
+      failures=$((failures + 1))
+    fi
+  done
+done
+
+exit $((failures != 0))
@@ -0,0 +1,100 @@
+#!/bin/sh
+# Checks that a compressed file is searched as the text it decompresses to: the output and exit status
+# of EXE on X.gz (or X.zst) must be grep's on X. Covered: several concatenated members or frames,
+# trailing zero padding, a line longer than the 1 MiB ring buffer, an empty archive, and a truncated
+# archive, which must still give the lines decoded before the damage and then exit with status 2.
+#
+# Usage: decompression.sh EXE FORMAT...     (FORMAT: gz or zst, the formats EXE was built to decompress)
+
+set -u
+exe=$1
+shift
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+# Lines that compress poorly enough for a truncated archive to stop part way through them.
+lines()
+{
+  awk -v first="$1" -v count="$2" 'BEGIN {
+    for (i = first; i < first + count; ++i)
+      printf "%s line %d %d\n", (i % 7 == 0 ? "warn" : "info"), i, (i * 2654435761) % 4294967296
+  }'
+}
+lines 0 40000 > "$dir/part1"
+lines 40000 40000 > "$dir/part2"
+lines 0 400000 > "$dir/large"
+{
+  echo 'warn before'
+  awk 'BEGIN { s = "x"; while (length(s) < 3 * 1024 * 1024) s = s s; print "warn " s " end" }'
+  echo 'info after'
+} > "$dir/long"
+: > "$dir/empty"
+
+compress()
+{
+  case $1 in
+    gz) gzip -c ;;
+    zst) zstd -q -c ;;
+  esac
+}
+
+decompress()
+{
+  case $1 in
+    gz) gzip -dc ;;
+    zst) zstd -q -dc ;;
+  esac
+}
+
+failures=0
+# check NAME ARCHIVE TEXT STATUS: EXE on ARCHIVE prints what grep prints on TEXT, and exits with STATUS.
+check()
+{
+  for options in '-n warn' '-c warn' '-l warn'; do
+    # shellcheck disable=SC2086
+    grep $options < "$3" | sed "s|^(standard input)\$|$2|" > "$dir/expected"
+    # shellcheck disable=SC2086
+    "$exe" $options "$2" > "$dir/actual" 2> "$dir/errors"
+    status=$?
+    expected_status=$4
+    if [ "$options" = '-l warn' ] && [ "$4" -eq 2 ]; then
+      expected_status=0                     # -l stops at the first match, before the damage
+    fi
+    if [ "$status" -ne "$expected_status" ] || ! cmp -s "$dir/expected" "$dir/actual"; then
+      echo "$1 ($options): exit status $status, expected $expected_status; output differs from grep:"
+      diff "$dir/expected" "$dir/actual" | head -n 5
+      cat "$dir/errors"
+      failures=$((failures + 1))
+    fi
+  done
+}
+
+for format in "$@"; do
+  if ! command -v "$(if [ "$format" = gz ]; then echo gzip; else echo zstd; fi)" > /dev/null; then
+    echo "skipping $format: no command line tool to make the archives"
+    continue
+  fi
+  archive=$dir/archive.$format
+
+  compress "$format" < "$dir/part1" > "$archive"
+  compress "$format" < "$dir/part2" >> "$archive"
+  cat "$dir/part1" "$dir/part2" > "$dir/text"
+  check "$format concatenated" "$archive" "$dir/text" 0
+
+  compress "$format" < "$dir/part1" > "$archive"
+  head -c 4096 /dev/zero >> "$archive"
+  check "$format padded" "$archive" "$dir/part1" 0
+
+  compress "$format" < "$dir/long" > "$archive"
+  check "$format long line" "$archive" "$dir/long" 0
+
+  compress "$format" < "$dir/empty" > "$archive"
+  check "$format empty" "$archive" "$dir/empty" 1
+
+  compress "$format" < "$dir/large" > "$dir/whole"
+  head -c $(($(wc -c < "$dir/whole") / 2)) "$dir/whole" > "$archive"
+  decompress "$format" < "$archive" > "$dir/text" 2> /dev/null
+  check "$format truncated" "$archive" "$dir/text" 2
+done
+
+exit $((failures != 0))
@@ -0,0 +1,119 @@
+// Checks that the compile-time matchers, grepcpp::match and grepcpp::search, give the same result as
+// match_main: the same verdict, the same match and the same span for every group. StaticMatcher runs its
+// own implementation of every opcode, so each case aims at one of them (Repeat, Progress, Backref, ...).
+// A few cases are also evaluated by the compiler itself. Disagreements are printed and fail the test.
+
+#include <cstdio>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "main.hpp"
+#include "match.hpp"
+#include "match_scratch.hpp"
+#include "static_match.hpp"
+
+
+// `pattern` matched against a whole text: wrapped in ^(...)$, its back references renumbered past the new group.
+static std::string wholeTextPattern(std::string_view pattern)
+{
+  std::string anchored = "^(";
+  for (size_t i = 0; i < pattern.size(); ++i)
+  {
+    anchored.push_back(pattern[i]);
+    if (pattern[i] == '\\' && i + 1 < pattern.size())
+    {
+      char next = pattern[++i];
+      if (next >= '1' && next <= '9')
+      {
+        if (next == '9')
+        {
+          throw std::runtime_error("cannot renumber back reference \\9");
+        }
+        ++next;
+      }
+      anchored.push_back(next);
+    }
+  }
+  return anchored + ")$";
+}
+
+// Where a group landed in the text: {offset, length}, or {-1, 0} when it took no part.
+static std::pair<long, size_t> groupSpan(std::string_view group, std::string_view text)
+{
+  return group.data() == nullptr ? std::pair<long, size_t>{ -1, 0 } : std::pair<long, size_t>{ group.data() - text.data(), group.size() };
+}
+
+// Whether grepcpp::match and grepcpp::search agree with match_main on `input`: same verdict, same match and
+// the same span for every group. Disagreements are printed.
+template <grepcpp::FixedString Pattern>
+static bool enginesAgree(std::string_view input)
+{
+  bool agreed = true;
+  for (const bool whole_text : { true, false })
+  {
+    auto pattern = compilePattern(whole_text ? wholeTextPattern(Pattern.view()) : std::string(Pattern.view()));
+    MatchScratch scratch{};
+    prepareMatchScratch(scratch, pattern);
+    Match runtime{};
+    const bool runtime_matched = findMatch(pattern, scratch, input.data(), input.data(), input.data() + input.size(), true,
+      runtime) == MatchStatus::Match;
+    const auto fixed = whole_text ? grepcpp::match<Pattern>(input) : grepcpp::search<Pattern>(input);
+
+    // The whole-text wrapper is group 1 of the run-time pattern, so its groups are one further along.
+    const size_t group_shift = whole_text ? 1 : 0;
+    bool same = runtime_matched == fixed.matched;
+    for (size_t group = 0; same && runtime_matched && group < fixed.groups.size(); ++group)
+    {
+      same = groupSpan(fixed.group(group), input) == groupSpan(runtime.group(group == 0 ? 0 : group + group_shift), input);
+    }
+    if (!same)
+    {
+      std::fprintf(stderr, "%s: grepcpp::%s and match_main disagree on \"%.*s\"\n", std::string(Pattern.view()).c_str(),
+        whole_text ? "match" : "search", static_cast<int>(input.size()), input.data());
+      agreed = false;
+    }
+  }
+  return agreed;
+}
+
+// enginesAgree over every input.
+template <grepcpp::FixedString Pattern>
+static bool agreementCase(std::initializer_list<std::string_view> inputs)
+{
+  bool agreed = true;
+  for (auto input : inputs)
+  {
+    agreed &= enginesAgree<Pattern>(input);
+  }
+  return agreed;
+}
+
+// The compile-time matchers evaluated by the compiler itself.
+static_assert(grepcpp::match<"(\\w+)@(\\w+)\\.com">("jane_doe@example.com").group(2) == "example");
+static_assert(!grepcpp::match<"\\d{1,3}">("1234"));
+static_assert(grepcpp::search<"\"[^\"]{20,40}\"">("say \"abcdefghijklmnopqrstuvwxyz\" now").text().size() == 28);
+static_assert(grepcpp::search<"(a|b)*c">("xxabac").group(1) == "a");
+static_assert(!grepcpp::match<"(a*)*b">("aaaa"));
+static_assert(grepcpp::match<"(\\w+) \\1">("hey hey") && !grepcpp::match<"(\\w+) \\1">("hey you"));
+
+
+int main()
+{
+  bool agreed = true;
+  // The inputs of the benchmark's validation rows, then one or more cases per instruction.
+  agreed &= agreementCase<"(\\w+)@(\\w+)\\.com">({ "jane_doe@example.com", "jane@example.org", "@example.com" });
+  agreed &= agreementCase<"\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}\\.\\d{1,3}">({ "192.168.100.7", "1921.168.100.7", "ip 10.0.0.255 up" });
+  agreed &= agreementCase<"(GET|POST|PUT|DELETE) /\\S*">({ "POST /api/v1/orders", "PATCH /x", "DELETE /" });
+  agreed &= agreementCase<"\"[^\"]{20,40}\"">({ "say \"abcdefghijklmnopqrstuvwxyz\" now", "\"short\"", "\"\"" });
+  agreed &= agreementCase<"x{2,20}y{17,}">({ "xxxyyyyyyyyyyyyyyyyyy", "xyyyyyyyyyyyyyyyyyyyy", "xxxxxyyyy" });
+  agreed &= agreementCase<"(a|b)*c">({ "xxabac", "c", "ab", "" });
+  agreed &= agreementCase<"(a*)*b|(a|)+c">({ "aaab", "aaac", "aaaa", "c" });
+  agreed &= agreementCase<"(a|ab)(c|bcd)(d*)">({ "abcd", "abcdd", "acd" });
+  agreed &= agreementCase<"(\\w+) \\1">({ "hello hello", "hello world", "say bye bye" });
+  agreed &= agreementCase<"^(\\d+)-(\\d*)$|(x)">({ "12-", "12-34", "a12-34", "box" });
+  std::fputs(agreed ? "grepcpp::match and grepcpp::search agree with match_main\n" : "disagreements found\n", stdout);
+  return agreed ? 0 : 1;
+}